@@ -0,0 +1,109 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+
+#include "types.hpp"
+
+namespace cvt
+{
+
+/*! @brief Run of in-zone pixels [x, end) within a row.
+*/
+struct Span
+{
+    int x;
+    int end;
+};
+
+
+/*! @brief The class keeps detector areas rasterized at a given resolution.
+
+    Besides an 8-bit mask for OpenCV functions it holds the in-zone pixels as per-row spans and their bounding
+    rectangle, so a kernel walks only the pixels it cares about and a narrow zone costs proportionally little.
+    Its usage looks like
+    @code{.cpp}
+        const cvt::AreaMask& zone = settings->areaMask();
+        int changed = 0;
+        zone.forEachSpan([&](int y, const cvt::Span& span)
+        {
+            const uchar* row = diff.ptr<uchar>(y);
+            for ( int x = span.x; x < span.end; ++x ) changed += ( row[x] > 0 );
+        });
+    @endcode
+*/
+class AreaMask final
+{
+public:
+    AreaMask() = default;
+
+    /*! @param areas areas in coordinates of the given resolution
+        @param size resolution
+    */
+    AreaMask(const Areas& areas, cv::Size size);
+
+    ~AreaMask() = default;
+
+    bool empty() const noexcept;
+
+    cv::Size size() const noexcept;
+
+    /*! @brief Returns the mask of CV_8U type, 255 inside of the areas.
+    */
+    const cv::Mat& mask() const noexcept;
+
+    /*! @brief Returns the bounding rectangle of all in-zone pixels.
+    */
+    const cv::Rect& boundingRect() const noexcept;
+
+    /*! @brief Returns the number of in-zone pixels (overlapping areas are counted once).
+    */
+    int area() const noexcept;
+
+    /*! @brief Returns all spans, row by row.
+    */
+    const std::vector<Span>& spans() const noexcept;
+
+    /*! @brief Returns spans of the row as [first, last) pointers.
+    */
+    std::pair<const Span*, const Span*> rowSpans(int y) const noexcept;
+
+    bool contains(cv::Point pt) const noexcept;
+
+    /*! @brief Calls f(y, span) for every span within rows [yBegin, yEnd).
+    */
+    template <typename F>
+    void forEachSpan(int yBegin, int yEnd, F&& f) const
+    {
+        yBegin = std::max(yBegin, m_boundingRect.y);
+        yEnd = std::min(yEnd, m_boundingRect.y + m_boundingRect.height);
+        for ( int y = yBegin; y < yEnd; ++y )
+        {
+            const auto row = rowSpans(y);
+            for ( const Span* span = row.first; span != row.second; ++span )
+            {
+                f(y, *span);
+            }
+        }
+    }
+
+    template <typename F>
+    void forEachSpan(F&& f) const
+    {
+        forEachSpan(0, m_size.height, std::forward<F>(f));
+    }
+
+private:
+    cv::Size m_size;
+    cv::Mat m_mask;
+    cv::Rect m_boundingRect;
+    int m_area { 0 };
+    std::vector<Span> m_spans;
+    std::vector<int> m_rowStarts; //!< spans of row y are [m_rowStarts[y], m_rowStarts[y + 1])
+};
+
+}
@@ -0,0 +1,140 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <future>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <vector>
+#include <string>
+
+#include "detector.hpp"
+#include "spsc_queue.hpp"
+
+namespace cvt
+{
+
+/*! @brief The class overlaps the stages of a detector on consecutive frames.
+
+    Preprocessing, inference and postprocessing run on three threads, so frame N+1 may be preprocessed while frame N
+    is in the network and frame N-1 in NMS (see Detector::preprocess()). Results come out in submission order.
+    Its usage looks like
+    @code{.cpp}
+        cvt::AsyncDetectorRunner runner(detector, 3);
+
+        std::future<cvt::Detector::OutputData> result = runner.submit(cvt::Detector::InputData(frame));
+        ...
+        cvt::Detector::OutputData out = result.get();
+    @endcode
+*/
+class AsyncDetectorRunner final
+{
+public:
+    using Completion = std::function<void(const Detector::Job& job)>;
+
+    using Release = std::function<void()>;
+
+    /*! @param detector detector to run
+        @param depth max number of frames in flight
+        @param completion (optional) called for every finished frame on the postprocessing thread, in order
+        @param release (optional) called on the postprocessing thread whenever a frame has left, i.e. there is room
+               for one more (see trySubmit())
+        @param name detector name stage failures are logged with
+    */
+    AsyncDetectorRunner(const std::shared_ptr<Detector>& detector, int depth = 3, Completion completion = nullptr,
+                        Release release = nullptr, const std::string& name = "detector");
+
+    AsyncDetectorRunner(const AsyncDetectorRunner&) = delete;
+
+    AsyncDetectorRunner& operator=(const AsyncDetectorRunner&) = delete;
+
+    /*! @brief Finishes the frames in flight.
+    */
+    ~AsyncDetectorRunner();
+
+    /*! @brief Queues the frame. Blocks while depth frames are in flight. Must be called from one thread.
+    */
+    std::future<Detector::OutputData> submit(Detector::InputData&& in);
+
+    /*! @brief Queues the frame unless depth frames are in flight. Never blocks. Must be called from the same thread as submit().
+
+        The result comes out through the completion only, a frame failed by a stage is logged and counted (see failedFrames()).
+        A refused frame is left intact.
+
+        @return false if the frame was refused
+    */
+    bool trySubmit(Detector::InputData& in);
+
+    /*! @brief Waits for all frames in flight and stops the stage threads.
+    */
+    void finish();
+
+    int depth() const noexcept;
+
+    int inFlight() const;
+
+    /*! @brief Returns CPU time spent in all stages in ms.
+    */
+    double cpuTime() const noexcept;
+
+    /*! @brief Returns average (EMA) time of a stage (0 - preprocess, 1 - infer, 2 - postprocess) in ms.
+    */
+    double stageTime(int stage) const noexcept;
+
+    /*! @brief Returns the number of frames a stage has thrown on.
+    */
+    std::int64_t failedFrames() const noexcept;
+
+    std::string summary() const;
+
+private:
+    struct Task
+    {
+        Detector::Job job;
+        std::promise<Detector::OutputData> promise;
+        bool promised { false }; //!< queued by submit(), so the result goes to the promise
+        bool failed { false };
+    };
+
+    using TaskPtr = std::unique_ptr<Task>;
+
+    enum Stage
+    {
+        PREPROCESS,
+        INFER,
+        POSTPROCESS,
+        STAGES
+    };
+
+    std::shared_ptr<Detector> m_detector;
+    const std::string m_name;
+    const int m_depth;
+    Completion m_completion;
+    Release m_release;
+    std::unique_ptr<SpscQueue<TaskPtr>> m_queues[STAGES];
+    std::thread m_threads[STAGES];
+    std::atomic<bool> m_stop { false };
+    std::atomic<double> m_stageMs[STAGES];
+    std::atomic<std::int64_t> m_cpuTimeUs { 0 };
+    std::atomic<std::int64_t> m_failedFrames { 0 };
+
+    int m_inFlight { 0 };
+    std::vector<TaskPtr> m_freeTasks; //!< depth tasks reused frame after frame, guarded by m_mutex
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    /*! @brief Takes a task off the free list. The caller must hold m_mutex and have counted the task in m_inFlight.
+    */
+    TaskPtr acquire();
+
+    /*! @brief Logs the exception being handled and fails the task. Must be called from a catch block.
+    */
+    void fail(Task& task, int stage, const char* what);
+
+    void stageLoop(int stage);
+};
+
+}
@@ -1,15 +1,28 @@
 #pragma once
 
 #include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
+#include "frame_pool.hpp"
+#include "video_index.hpp"
+#include "frame_store.hpp"
+#include "image_sequence.hpp"
+#include "video_writer.hpp"
+
 namespace cvt
 {
 
 const static std::vector<std::string> supportedImageContainers = { ".bmp", ".jpg", ".png", ".tif" };
 const static std::vector<std::string> supportedVideoContainers = { ".avi", ".mkv", ".mp4", ".mov" };
+const static std::string frameStoreContainer = ".cvr";
 
 class OpenCVPlayer final
 {
@@ -20,7 +33,9 @@ public:
         IMAGE, //!< indicates that the input is an iamge
         VIDEO, //!< indicates that the input is a recorded video
         LIVESTREAM, //!< indicates that the input is a live stream
-        WEBCAM //!< indicates that the input is a webcam stream
+        WEBCAM, //!< indicates that the input is a webcam stream
+        RECORDING, //!< indicates that the input is a raw frame store (see FrameStoreWriter)
+        IMAGE_SEQUENCE //!< indicates that the input is a directory or a glob pattern of images
     };
 
     OpenCVPlayer(const std::string& input, double scaleFactor = 1.0);
@@ -31,10 +46,30 @@ public:
 
     void read(cv::Mat& out);
 
+    /*! @brief Advances to the next frame without decoding it.
+
+        @return false if there are no more frames
+    */
+    bool grab();
+
     OpenCVPlayer& operator >> (cv::Mat& out);
 
+    /*! @brief Reads the next frame into a pooled buffer and stamps it with frame number and timestamp.
+    */
+    OpenCVPlayer& operator >> (const FrameHandle& out);
+
+    /*! @brief Records the frame. Encoding runs on a background thread (see AsyncVideoWriter).
+    */
     void write(const cv::Mat& frame);
 
+    /*! @brief Sets output path, codec and queue policy of the recording. Must be called before the first write().
+    */
+    void setWriterParams(const AsyncVideoWriter::Params& params);
+
+    /*! @brief Returns the recorder (for its statistics) or nullptr if nothing has been recorded.
+    */
+    const AsyncVideoWriter* writer() const noexcept;
+
     OpenCVPlayer& operator << (const cv::Mat& frame);
 
     double get(int propId) const;
@@ -43,27 +78,184 @@ public:
 
     void backToStart();
 
+    /*! @brief Moves a recorded video to the given frame so that the next read() returns exactly it.
+
+        With the keyframe index the capture jumps to the preceding keyframe and decodes only the rest of its GOP.
+
+        @return false if the input is not seekable
+    */
+    bool seek(int frameNum);
+
+    /*! @brief Moves a recorded video to the frame presented at the given time (ms from the first frame).
+    */
+    bool seekTimestamp(std::int64_t timestampMs);
+
+    bool seekable() const noexcept;
+
+    /*! @brief Says whether the last read frame is a keyframe. Always true for images and false if unknown.
+    */
+    bool isKeyframe() const noexcept;
+
+    /*! @brief Returns the keyframe index. It stays empty while the index is being built in background.
+    */
+    const VideoIndex& index() const noexcept;
+
     const cv::Mat& frame0() const noexcept;
 
     const double fps() const noexcept;
 
+    /*! @brief Overrides the nominal frame rate.
+
+        Image sequences then get timestamps from the rate instead of file modification times.
+    */
+    void setFrameRate(double fps);
+
     int frameNum() const noexcept;
 
     std::int64_t timestamp() const noexcept;
 
     int getInputType(const std::string& input) const;
 
+    /*! @brief Enables decode-ahead mode.
+
+        A background thread decodes (and resizes) frames into a bounded ring of preallocated slots,
+        so read() only hands back the next ready slot. The matrix passed to read() is recycled into the ring.
+
+        @param capacity number of ring slots
+    */
+    void enablePrefetch(int capacity = 4);
+
+    /*! @brief Stops the decode thread and returns to synchronous reading.
+    */
+    void disablePrefetch();
+
+    bool prefetching() const noexcept;
+
+    /*! @brief Returns the number of decoded frames waiting in the ring.
+    */
+    int prefetchFillLevel() const;
+
+    /*! @brief Returns how many times read() had to wait for the decoder.
+    */
+    std::int64_t prefetchUnderruns() const noexcept;
+
+    /*! @brief Enables live mode for live streams and webcams.
+
+        A background thread keeps grabbing without decoding, so that the backend buffer never builds up,
+        and read() decodes only the newest grabbed frame. Frames which were replaced before the consumer got to them are skipped.
+        Timestamps come from stream PTS if it is available and from a monotonic capture clock otherwise.
+    */
+    void enableLiveMode();
+
+    void disableLiveMode();
+
+    bool liveMode() const noexcept;
+
+    /*! @brief Returns the number of frames skipped in live mode.
+    */
+    std::int64_t skippedFrames() const noexcept;
+
 private:
     const std::string m_input { "0" };
     const cv::Size m_inputSize { 0, 0 };
     cv::VideoCapture m_capture;
-    cv::VideoWriter m_writer;
+    std::unique_ptr<AsyncVideoWriter> m_writer;
+    AsyncVideoWriter::Params m_writerParams;
     int m_inputType { InputType::NONE };
     double m_scaleFactor { 1.0 };
     bool m_doResize { false };
     cv::Mat m_frame0;
-    double m_fps;
+    double m_fps { 0.0 };
     int m_frameNum { 0 };
+    VideoIndex m_index;
+
+    /* Background index build */
+    struct
+    {
+        std::thread thread;
+        VideoIndex built;
+        std::atomic<bool> ready { false };
+        std::atomic<bool> cancel { false };
+    } m_indexBuild;
+    FrameStoreReader m_store;
+    int m_storePos { 0 };
+    std::unique_ptr<ImageSequenceReader> m_sequence;
+
+    /* Prefetch stuff */
+    struct
+    {
+        std::thread thread;
+        std::vector<cv::Mat> slots;
+        int head { 0 };
+        int count { 0 };
+        bool enabled { false };
+        bool stop { false };
+        bool eof { false };
+        std::atomic<std::int64_t> underruns { 0 };
+        mutable std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable notFull;
+    } m_prefetch;
+
+    /* Live mode stuff */
+    struct
+    {
+        std::thread thread;
+        bool fresh { false }; //!< a grabbed frame is waiting for retrieve()
+        bool enabled { false };
+        bool stop { false };
+        bool eof { false };
+        int frameNum { 0 }; //!< number of frames grabbed from the stream
+        int consumers { 0 }; //!< threads about to take a frame, the grabber lets them have the capture first
+        std::int64_t timestamp { -1 };
+        std::atomic<std::int64_t> skipped { 0 };
+        std::mutex mutex;
+        std::condition_variable notEmpty;
+        std::condition_variable taken;
+    } m_live;
+    std::int64_t m_liveTimestamp { -1 };
+
+    mutable std::mutex m_captureMutex;
+    cv::Mat m_decodeBuffer;
+    cv::Mat m_skipBuffer;
+
+    void decode(cv::Mat& out);
+
+    /*! @brief Decodes the last grabbed frame (and resizes it).
+    */
+    void retrieve(cv::Mat& out);
+
+    void openIndex();
+
+    /*! @brief Takes over the index once the background build has finished.
+    */
+    void adoptIndex();
+
+    void openRecording();
+
+    void openSequence();
+
+    void seekCapture(int frameNum);
+
+    void startPrefetchThread();
+
+    void stopPrefetchThread();
+
+    void prefetchLoop();
+
+    void startLiveThread();
+
+    void stopLiveThread();
+
+    /*! @brief Waits for a grabbed frame and takes it over.
+
+        @param captureLock unlocked lock of m_captureMutex, it is locked on return so that the frame can be retrieved
+
+        @return false if the stream has ended
+    */
+    bool takeLiveFrame(std::unique_lock<std::mutex>& captureLock);
+
+    void liveLoop();
 };
 
 }
\ No newline at end of file
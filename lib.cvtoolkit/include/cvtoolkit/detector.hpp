@@ -6,6 +6,10 @@
 
 #include "utils.hpp"
 #include "settings.hpp"
+#include "area_mask.hpp"
+#include "frame_pool.hpp"
+#include "sampling_policy.hpp"
+#include "snapshot.hpp"
 #include "nndetector.hpp"
 
 #include <nlohmann/json.hpp>
@@ -38,6 +42,11 @@ public:
         unsigned int imType { 0 };
         unsigned int imStep { 0 };
         std::int64_t timestamp { -1 };
+        std::int64_t captureTime { -1 }; //!< steady clock time (ms) the frame was captured at, see steadyClockMs()
+        bool keyframe { false }; //!< the frame is a keyframe of the stream (false if unknown)
+        FrameHandle frame; //!< (optional) keeps the pooled buffer behind imData alive while queued
+
+        InputData() = default;
 
         InputData(bool retval, const unsigned char* imData, unsigned int imType, unsigned int imStep, std::int64_t timestamp)
             : retval(retval)
@@ -45,6 +54,19 @@ public:
             , imType(imType)
             , imStep(imStep)
             , timestamp(timestamp)
+            , captureTime(steadyClockMs())
+        {
+        }
+
+        explicit InputData(const FrameHandle& frame)
+            : retval(frame && !frame->image.empty())
+            , imData(frame ? frame->image.data : nullptr)
+            , imType(frame ? static_cast<unsigned int>(frame->image.type()) : 0)
+            , imStep(frame ? static_cast<unsigned int>(frame->image.step.p[0]) : 0)
+            , timestamp(frame ? frame->timestamp : -1)
+            , captureTime((frame && frame->captureTime >= 0) ? frame->captureTime : steadyClockMs())
+            , keyframe(frame && frame->keyframe)
+            , frame(frame)
         {
         }
         
@@ -54,22 +76,46 @@ public:
         InputData& operator=(InputData&& other) = default;
     };
 
+    /*! @brief Event found on a frame.
+
+        Outputs are recycled (see DetectorThreadManager::recycle()), so detectors fill them with clear() and
+        emplace_back() rather than by assigning new containers, and in steady state an event costs no allocations.
+    */
     struct OutputData
     {
         bool event { false };
         std::vector<cv::Rect> eventRects { };
         std::int64_t eventTimestamp { -1 };
-        std::string eventDescr { "" };
+        std::string_view eventDescr { }; //!< static text
         InferOuts eventInferOuts;
-        cv::Mat eventDetailedFrame;
+        FrameHandle eventFrame; //!< (display-detailed) the frame the event was found on, see detailedFrame()
 
-        OutputData(bool event = false, const std::vector<cv::Rect>& eventRects = { }, std::int64_t eventTimestamp = -1, std::string eventDescr = "")
+        OutputData(bool event = false, const std::vector<cv::Rect>& eventRects = { }, std::int64_t eventTimestamp = -1, 
+                   std::string_view eventDescr = { })
             : event(event)
             , eventRects(eventRects)
             , eventTimestamp(eventTimestamp)
             , eventDescr(eventDescr)
         {
         }
+
+        /*! @brief Empties the output but keeps its buffers.
+        */
+        void reset() noexcept
+        {
+            event = false;
+            eventRects.clear();
+            eventTimestamp = -1;
+            eventDescr = { };
+            eventInferOuts.clear();
+            eventFrame.reset();
+        }
+
+        /*! @brief Draws the event over its frame at the given (detector) resolution.
+
+            @return false if the event has no frame
+        */
+        bool detailedFrame(cv::Size size, cv::Mat& out) const;
         
         OutputData(const OutputData&) = default;
         OutputData& operator=(const OutputData&) = default;
@@ -77,15 +123,104 @@ public:
         OutputData& operator=(OutputData&& other) = default;
     };
 
+    /*! @brief State of one frame on its way through preprocess(), infer() and postprocess().
+    */
+    struct Job
+    {
+        InputData in;
+        OutputData out;
+        bool skip { false }; //!< set by a stage to leave the frame out of the next ones
+        cv::Mat input; //!< frame prepared for the model
+        cv::Mat blob; //!< model input
+        std::vector<cv::Mat> raw; //!< model output
+        std::vector<cv::Rect> rois; //!< (optional) frame regions the model runs on instead of the whole frame
+    };
+
     virtual ~Detector() = default;
 
     virtual void process(const InputData& in, OutputData& out) = 0;
 
+    /*! @brief Processes several frames (from different streams or consecutive ones) at once.
+
+        The default implementation calls process() for every frame. Detectors built on a network
+        override it to run the whole batch through one forward pass.
+
+        @param in input frames
+        @param out outputs, one per input frame
+    */
+    virtual void processBatch(const std::vector<InputData>& in, std::vector<OutputData>& out)
+    {
+        out.resize(in.size());
+        for ( size_t i = 0; i < in.size(); ++i )
+        {
+            out[i].reset();
+            process(in[i], out[i]);
+        }
+    }
+
+    /*! @brief Stages of process() which AsyncDetectorRunner runs on different frames at the same time.
+
+        Each stage is called for one frame at a time and in frame order, but different stages may run concurrently,
+        so they must not share mutable state. By default the whole process() runs as infer().
+    */
+    virtual void preprocess(Job& job)
+    {
+    }
+
+    virtual void infer(Job& job)
+    {
+        process(job.in, job.out);
+    }
+
+    virtual void postprocess(Job& job)
+    {
+    }
+
+    /*! @brief Returns frame representations the detector consumes.
+
+        If the ingestion stage has produced them, they are available via InputData::frame->planes
+        and the detector does not need to convert or resize the frame itself.
+    */
+    virtual PlaneSpecs requiredPlanes() const
+    {
+        return PlaneSpecs();
+    }
+
+    /*! @brief Writes what the detector has learned (background models, estimators, triggers) into the snapshot.
+
+        Restoring it with loadState() after a restart saves minutes of re-learning. Must not be called
+        while a frame is being processed.
+
+        @return false if the detector has nothing worth saving
+    */
+    virtual bool saveState(SnapshotWriter& snapshot) const
+    {
+        return false;
+    }
+
+    /*! @brief Restores the state written by saveState().
+
+        @return false if the snapshot does not fit the detector (e.g. it was taken at another resolution)
+    */
+    virtual bool loadState(SnapshotReader& snapshot)
+    {
+        return false;
+    }
+
 protected:
     std::shared_ptr<MetricMaster> m_metrics;
 };
 
 
+/*! @brief Admission control of frames on their way to a detector.
+*/
+struct AdmissionSettings
+{
+    std::int64_t maxFrameAgeMs { 0 }; //!< frames older than this are dropped at dequeue (0 - never)
+    bool adaptive { false }; //!< admit frames no faster than the detector processes them
+};
+
+
 /*! @brief The base class for all detector settings.
 */
 class DetectorSettings
@@ -99,19 +234,58 @@ public:
 
     double fps() const noexcept;
 
+    /*! @brief Returns how the detector picks frames to process ("sampling", or a fixed "process-freq-ms" rate).
+    */
+    const SamplingSettings& sampling() const noexcept;
+
+    /*! @brief Returns the sampling period, i.e. sampling().periodMs.
+    */
     std::int64_t processFreqMs() const noexcept;
 
     const Areas& areas() const noexcept;
 
+    /*! @brief Returns areas rasterized at "detector-resolution".
+    */
+    const AreaMask& areaMask() const noexcept;
+
     bool displayDetailed() const noexcept;
 
+    const AdmissionSettings& admission() const noexcept;
+
+    /*! @brief Returns how many frames may be in flight through the detector stages ("pipeline-depth", 1 - synchronous).
+    */
+    int pipelineDepth() const noexcept;
+
+    /*! @brief Returns how many queued frames go through the detector at once ("batch-size", 1 - one by one).
+    */
+    int batchSize() const noexcept;
+
+    /*! @brief Returns true if the detector should run only on the bounding rectangles of its areas ("crop-to-areas").
+    */
+    bool cropToAreas() const noexcept;
+
+    /*! @brief Returns the file the detector state is kept in between runs ("snapshot-path", empty - not kept).
+    */
+    const std::string& snapshotPath() const noexcept;
+
+    /*! @brief Returns how often the state is saved while running ("snapshot-period-ms", 0 - only on exit).
+    */
+    std::int64_t snapshotPeriodMs() const noexcept;
+
 protected:
     const std::string m_instanceName;
     double m_fps;
     cv::Size m_detectorResolution;
-    std::int64_t m_processFreqMs { 0 };
+    SamplingSettings m_sampling;
     Areas m_areas;
+    AreaMask m_areaMask;
     bool m_displayDetailed { false };
+    AdmissionSettings m_admission;
+    int m_pipelineDepth { 1 };
+    int m_batchSize { 1 };
+    bool m_cropToAreas { false };
+    std::string m_snapshotPath;
+    std::int64_t m_snapshotPeriodMs { 60000 };
 
 private:
     void parseCommonJsonSettings(const json& j);
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "../utils.hpp"
+#include "../detector_manager.hpp"
+
+namespace cvt
+{
+
+class OptflowMotionDetector;
+
+
+class CascadeDetectorSettings final : public DetectorSettings
+{
+public:
+    enum Gate
+    {
+        FRAME_DIFF, //!< "frame-diff": share of changed pixels between consecutive frames
+        OPTFLOW //!< "optflow-motion-detector": events of OptflowMotionDetector
+    };
+
+    CascadeDetectorSettings(const Detector::InitializeData& iData, const json& jSettings);
+
+    ~CascadeDetectorSettings() = default;
+
+    void parseJsonSettings(const json& j);
+
+    int gate() const noexcept;
+
+    int diffThreshold() const noexcept;
+
+    double motionThreshold() const noexcept;
+
+    std::int64_t holdOpenMs() const noexcept;
+
+    bool perArea() const noexcept;
+
+private:
+    int m_gate { Gate::FRAME_DIFF };
+    int m_diffThreshold { 25 };
+    double m_motionThreshold { 0.002 };
+    std::int64_t m_holdOpenMs { 3000 };
+    bool m_perArea { false };
+};
+
+
+/*! @brief The class runs an expensive detector only when a cheap motion gate lets it.
+
+    The gate is either frame differencing at "detector-resolution" or OptflowMotionDetector. Once it has seen motion,
+    the gate stays open for "hold-open-ms" more. With "per-area" every area is tested on its own, so motion in a small
+    zone is not diluted by the rest of the frame. Its usage looks like
+    @code{.cpp}
+        auto yolo = std::make_shared<cvt::YOLOObjectDetector>(yoloInitData);
+        auto cascade = std::make_shared<cvt::CascadeDetector>(cascadeInitData, yolo);
+        auto detectorThread = std::make_unique<cvt::DetectorThreadManager>(cascade);
+    @endcode
+*/
+class CascadeDetector final : public Detector
+{
+public:
+    /*! @param iData initialize data of the cascade ("cascade-detector" settings)
+        @param detector the expensive detector
+        @param gate (optional) custom gate detector, its events open the gate (an optical flow gate stays open
+               while its motion lasts)
+    */
+    CascadeDetector(const Detector::InitializeData& iData, const std::shared_ptr<Detector>& detector,
+                    const std::shared_ptr<Detector>& gate = nullptr);
+
+    ~CascadeDetector();
+
+    void process(const Detector::InputData& in, Detector::OutputData& out) override;
+
+    void processBatch(const std::vector<Detector::InputData>& in, std::vector<Detector::OutputData>& out) override;
+
+    void preprocess(Detector::Job& job) override;
+
+    void infer(Detector::Job& job) override;
+
+    void postprocess(Detector::Job& job) override;
+
+    PlaneSpecs requiredPlanes() const override;
+
+    /*! @brief Saves the states of the gate and of the detector.
+    */
+    bool saveState(SnapshotWriter& snapshot) const override;
+
+    bool loadState(SnapshotReader& snapshot) override;
+
+    /*! @brief Returns the share of frames the expensive detector did not get.
+    */
+    double skipRatio() const noexcept;
+
+    std::int64_t gatedFrames() const noexcept;
+
+    std::int64_t passedFrames() const noexcept;
+
+    const std::shared_ptr<CascadeDetectorSettings>& settings() const noexcept;
+
+    const std::shared_ptr<Detector>& detector() const noexcept;
+
+private:
+    std::shared_ptr<CascadeDetectorSettings> m_settings;
+    std::shared_ptr<Detector> m_detector;
+    std::shared_ptr<Detector> m_gate;
+    OptflowMotionDetector* m_optflowGate { nullptr }; //!< m_gate if it is the optical flow detector
+    Detector::OutputData m_gateOut;
+    std::unique_ptr<SamplingPolicy> m_sampling; //!< sampling of the gate, driven by events of the detector
+    cv::Size m_imSize;
+
+    /* Frame differencing stuff */
+    std::vector<AreaMask> m_areaMasks; //!< one mask per area with "per-area", else one for all of them
+    cv::Mat m_gray;
+    cv::Mat m_prevGray;
+
+    /* Batching stuff */
+    std::vector<size_t> m_openOwners; //!< indices of frames which make up the batch
+    std::vector<Detector::InputData> m_openIn;
+    std::vector<Detector::OutputData> m_openOut;
+
+    std::int64_t m_lastMotionMs { -1 };
+    std::atomic<std::int64_t> m_gatedFrames { 0 };
+    std::atomic<std::int64_t> m_passedFrames { 0 };
+
+    /*! @brief Decides whether the frame goes to the expensive detector.
+    */
+    bool open(const Detector::InputData& in);
+
+    bool frameDiffMotion(const Detector::InputData& in);
+};
+
+}
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <iostream>
+#include <atomic>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
@@ -36,12 +37,17 @@ public:
 
     const std::int64_t eventHolddownMs() const noexcept;
 
+    /*! @brief Returns the number of bins of the motion direction histogram ("direction-bins", 0 - not collected).
+    */
+    int directionBins() const noexcept;
+
 private:
     double m_decisionThresh { 0.1 };
     std::int64_t m_eventHoldoutMs { 0 };
     std::int64_t m_eventHolddownMs { 1000 };
     float m_minAcceptedVelocity { 5 };
     float m_maxAcceptedVelocity { -1 };
+    int m_directionBins { 0 };
 };
 
 
@@ -54,10 +60,30 @@ public:
 
     void process(const Detector::InputData& in, Detector::OutputData& out) override;
 
+    PlaneSpecs requiredPlanes() const override;
+
+    bool saveState(SnapshotWriter& snapshot) const override;
+
+    bool loadState(SnapshotReader& snapshot) override;
+
     const cv::Mat& flow() const noexcept;
 
+    /*! @brief Returns the binary motion mask, empty unless it is enabled with setMotionMaskEnabled().
+    */
     const cv::Mat& motion() const noexcept;
 
+    /*! @brief Makes the detector produce the motion mask, e.g. when the GUI displays it.
+    */
+    void setMotionMaskEnabled(bool enabled) noexcept;
+
+    /*! @brief Returns moving pixels of the last frame per direction ("direction-bins" bins, counterclockwise from +x).
+    */
+    const std::vector<int>& directionHistogram() const noexcept;
+
+    /*! @brief Returns true while motion lasts, i.e. from the frame the event is raised on until the trigger goes off.
+    */
+    bool motionOn() const noexcept;
+
     const std::shared_ptr<OptflowMotionDetectorSettings>& settings() const noexcept;
 
 private:
@@ -67,25 +93,26 @@ private:
     cv::Ptr<cv::DISOpticalFlow> m_disOpt;
 #endif
     cv::Size m_imSize;
-    std::int64_t m_lastProcessedFrameMs { -1 };
     EventTrigger m_eventTrigger;
     std::unique_ptr<GaussianEstimator> m_motionGaussian;
     std::shared_ptr<OptflowMotionDetectorSettings> m_settings;
+    std::unique_ptr<SamplingPolicy> m_sampling;
 
-    cv::Mat m_FlowAreaMask;
     cv::Mat m_Gray;
     cv::Mat m_PrevGray;
     cv::Mat m_Flow;
-    cv::Mat m_FlowUV[2];
-    cv::Mat m_FlowMagn;
-    cv::Mat m_FlowAngle;
     cv::Mat m_Motion;
-    double m_maxMotion;
-
-    bool filterByTimestamp(std::int64_t timestamp);
+    std::atomic<bool> m_motionMaskEnabled { false };
 
-    // void motionMask_experimental(const cv::Mat& flow, cv::Mat& out);
+    /* Motion energy stuff */
+    int m_stripeRows { 1 };
+    std::vector<int> m_stripeMoving; //!< moving pixels per stripe
+    std::vector<int> m_stripeHist; //!< direction histogram per stripe
+    std::vector<int> m_directionHist;
 
+    /*! @brief Counts moving pixels within the areas, in a single pass over the flow.
+    */
+    int motionEnergy();
 };
 
 }
\ No newline at end of file
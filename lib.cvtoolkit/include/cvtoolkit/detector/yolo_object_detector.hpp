@@ -48,16 +48,61 @@ public:
 
     void process(const Detector::InputData& in, Detector::OutputData& out) override;
 
+    void processBatch(const std::vector<Detector::InputData>& in, std::vector<Detector::OutputData>& out) override;
+
+    void preprocess(Detector::Job& job) override;
+
+    void infer(Detector::Job& job) override;
+
+    void postprocess(Detector::Job& job) override;
+
+    PlaneSpecs requiredPlanes() const override;
+
     const std::shared_ptr<YOLOObjectDetectorSettings>& settings() const noexcept;
 
 private:
     cv::Size m_imSize;
-    std::int64_t m_lastProcessedFrameMs { -1 };
     std::shared_ptr<YOLOObjectDetectorSettings> m_settings;
+    std::unique_ptr<SamplingPolicy> m_sampling;
     std::unique_ptr<YOLOObjectNNDetector> m_yoloDetector;
     ObjectClasses m_acceptedObjectClasses;
 
-    bool filterByTimestamp(std::int64_t timestamp);
+    /* Area cropping stuff */
+    std::vector<cv::Rect> m_cropRects; //!< bounding rectangles of areas in frame coordinates
+    std::vector<AreaMask> m_cropMasks; //!< areas the crops were made for, at detector resolution
+
+    /*! @brief Buffers kept from frame to frame, so that the steady state does not allocate.
+    
+        Pipeline stages run on their own threads, hence a set per entry point.
+    */
+    struct Scratch
+    {
+        std::vector<size_t> owners;
+        std::vector<cv::Mat> detInputs;
+        std::vector<cv::Mat> inputs;
+        std::vector<cv::Size> cropSizes;
+        std::vector<InferOuts> dOuts;
+        InferOuts merged;
+        InferOuts candidates;
+        std::vector<cv::Rect> boxes;
+        std::vector<float> confidences;
+        std::vector<int> indices;
+    };
+    Scratch m_preScratch; //!< used by preprocess()
+    Scratch m_postScratch; //!< used by postprocess()
+    Scratch m_batchScratch; //!< used by processBatch()
+
+    cv::Mat prepareInput(const Detector::InputData& in) const;
+
+    void initCrops();
+
+    cv::Mat fullFrame(const Detector::InputData& in) const;
+
+    /*! @brief Maps boxes found in crops to detector coordinates, keeps those inside their area and merges overlaps.
+    */
+    void mergeCrops(const InferOuts* cropOuts, size_t count, Scratch& scratch, InferOuts& out) const;
+
+    void makeOutput(const Detector::InputData& in, const cv::Mat& input, const InferOuts& dOuts, Detector::OutputData& out) const;
 
 };
 
@@ -1,123 +1,31 @@
 #pragma once
 
 #include <iostream>
-#include <queue>
-#include <mutex>
-#include <condition_variable>
 #include <atomic>
 #include <thread>
 #include <chrono>
+#include <functional>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
 
 #include <opencv2/core.hpp>
 
 #include "detector.hpp"
 #include "metrics.hpp"
+#include "spsc_queue.hpp"
+#include "detector_scheduler.hpp"
+#include "async_detector.hpp"
 
 
 namespace cvt
 {
 
-template<typename T>
-class ConcurrentQueue final
-{
-public:
-    ConcurrentQueue() = default;
-
-    ConcurrentQueue(const ConcurrentQueue<T> &) = delete;
-
-    ConcurrentQueue<T>& operator=(const ConcurrentQueue<T>&) = delete;
-
-    ConcurrentQueue(ConcurrentQueue<T> &&) = delete;
-
-    ConcurrentQueue<T>& operator=(ConcurrentQueue<T>&&) = delete;
-
-    ~ConcurrentQueue()
-    {
-        m_finish = true;
-        m_condition.notify_all();
-    }
-
-    void push(T&& t)
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        m_queue.emplace(std::move(t));
-        m_condition.notify_one();
-    }
-
-    std::shared_ptr<T> pop1(std::int64_t waitForMs)
-    {
-        using namespace std::chrono_literals;
-
-        std::unique_lock<std::mutex> lock(m_mutex);
-        m_condition.wait_for(lock, waitForMs * 1ms, [&]{ return !m_queue.empty() || m_finish; });
-        if (m_queue.empty())
-        {
-            return nullptr;
-        }
-
-        auto result = std::make_shared<T>( std::move(m_queue.front()) );
-        m_queue.pop();
-        return result;
-    }
-
-    std::queue<T> pop()
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_queue.empty() && !m_finish)
-            m_condition.wait(lock);
-
-        std::queue<T> result;
-        std::swap(result, m_queue);
-
-        return result;
-    }
-
-    std::queue<T> pop(std::int64_t waitForMs)
-    {
-        using namespace std::chrono_literals;
-
-        std::unique_lock<std::mutex> lock(m_mutex);
-        while (m_queue.empty() && !m_finish)
-        {
-            if (m_condition.wait_for(lock, waitForMs * 1ms) == std::cv_status::timeout)
-            {
-                break;
-            }
-        }
-
-        std::queue<T> result;
-        std::swap(result, m_queue);
-
-        return result;
-    }
-
-    int size() const
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return static_cast<int>(m_queue.size());
-    }
-
-    bool empty() const
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        return (static_cast<int>(m_queue.size()) == 0);
-    }
-
-    void clear()
-    {
-        std::lock_guard<std::mutex> lock(m_mutex);
-        std::queue<T> emptyQueue;
-        std::swap(emptyQueue, m_queue);
-    }
-    
-private:
-    std::queue<T> m_queue;
-    mutable std::mutex m_mutex;
-    std::condition_variable m_condition;
-    bool m_finish { false };
-};
-
+/*! @brief The class runs a detector on its own thread or on a shared DetectorScheduler.
 
+    Frames go in through submit() and events come out either through drain() or through callbacks.
+    Both queues are bounded single-producer/single-consumer rings: one thread submits frames and one takes events.
+*/
 class DetectorThreadManager final
 {
 public:
@@ -126,28 +34,139 @@ public:
 
     unsigned int detectorThreadID;
 
-    ConcurrentQueue<Detector::InputData> iDataQueue;
+    SpscQueue<Detector::InputData> iDataQueue;
 
-    ConcurrentQueue<Detector::OutputData> oDataQueue;
+    SpscQueue<Detector::OutputData> oDataQueue;
 
-    DetectorThreadManager(const std::shared_ptr<Detector>& detector, unsigned int threadID = 0);
+    /*! @param detector detector to run
+        @param threadID thread number for logging
+        @param queueCapacity capacity of input and output queues
+        @param inputPolicy what to do with a new frame if the detector lags behind (see SpscQueue::Policy)
+    */
+    DetectorThreadManager(const std::shared_ptr<Detector>& detector, unsigned int threadID = 0, 
+                          int queueCapacity = 64, int inputPolicy = SpscQueue<Detector::InputData>::OVERWRITE_OLDEST);
+
+    /*! @brief Runs the detector on the scheduler's pool instead of a dedicated thread.
+    */
+    DetectorThreadManager(const std::shared_ptr<Detector>& detector, const std::shared_ptr<DetectorScheduler>& scheduler,
+                          unsigned int threadID = 0, int queueCapacity = 64, 
+                          int inputPolicy = SpscQueue<Detector::InputData>::OVERWRITE_OLDEST);
 
     DetectorThreadManager(const DetectorThreadManager&) = delete;
 
     DetectorThreadManager& operator=(const DetectorThreadManager&) = delete;
 
-    DetectorThreadManager(DetectorThreadManager&& other);
+    /* Threads, the scheduler executor and FrameDispatcher subscriptions refer to the object, so it stays in place */
+    DetectorThreadManager(DetectorThreadManager&&) = delete;
 
-    DetectorThreadManager& operator=(DetectorThreadManager&& other);
+    DetectorThreadManager& operator=(DetectorThreadManager&&) = delete;
     
-    ~DetectorThreadManager() = default;
+    ~DetectorThreadManager();
 
     void run();
 
     void detectorThreadLoop();
 
+    /*! @brief Queues the frame for the detector.
+
+        @return false if the frame was not admitted (see setAdmission())
+    */
+    bool submit(Detector::InputData&& iData);
+
+    /*! @brief Sets admission control.
+
+        Frames older than max age are dropped when the detector gets to them, so end-to-end latency stays bounded
+        under overload. Adaptive admission lets frames in no faster than the measured detector latency.
+    */
+    void setAdmission(const AdmissionSettings& admission);
+
+    /*! @brief Lets up to depth frames through the detector stages at once (see AsyncDetectorRunner).
+
+        Must be called before run(). With depth 1 (default) frames are processed one by one.
+        On a shared scheduler a frame the stages have no room for is held back instead of blocking the worker.
+    */
+    void setPipelineDepth(int depth);
+
+    /*! @brief Lets the detector take up to size queued frames at once (see Detector::processBatch()).
+
+        Frames published from several streams or consecutive ones then share one forward pass.
+        Batching is not used together with pipelining.
+    */
+    void setBatchSize(int size);
+
+    /*! @brief Keeps the detector state in the file between runs (see Detector::saveState()).
+
+        run() restores the state if the file exists, the detector thread copies it every period
+        and a background thread writes the copy, so the detector never waits for the disk.
+        join() saves it once more when the detector stops. With pipelining the state is saved
+        only by join(). Must be called before run().
+
+        @param path snapshot file
+        @param periodMs how often to save while running (0 - only on exit)
+    */
+    void setSnapshot(const std::string& path, std::int64_t periodMs = 60000);
+
+    /*! @brief Returns the number of frames dropped at dequeue as too old.
+    */
+    std::int64_t staleFrames() const noexcept;
+
+    /*! @brief Returns the number of frames not admitted by adaptive admission.
+    */
+    std::int64_t rejectedFrames() const noexcept;
+
+    /*! @brief Returns the number of frames still queued when the detector stopped, so never processed.
+    */
+    std::int64_t abandonedFrames() const noexcept;
+
+    /*! @brief Returns average (EMA) detector latency in ms.
+
+        With pipelining it is the time of the slowest stage, i.e. how often the detector takes a frame.
+    */
+    double latency() const noexcept;
+
+    /*! @brief Returns capture time of the last processed frame or -1 if nothing has been processed yet.
+    */
+    std::int64_t lastProcessedCaptureTime() const noexcept;
+
+    using EventCallback = std::function<void(const Detector::OutputData&)>;
+
+    /*! @brief Registers a callback invoked for every event on a dedicated sink thread.
+
+        Must be called before run(). While callbacks are registered, drain() gets nothing.
+    */
+    void onEvent(EventCallback callback);
+
+    /*! @brief Moves all pending events out at once.
+
+        @param events vector the events are appended to (reuse it to avoid reallocations)
+
+        @return number of events moved out
+    */
+    int drain(std::vector<Detector::OutputData>& events);
+
+    /*! @brief Gives handled events back, so their buffers are reused by next events.
+
+        Releases the frames the events refer to and empties the vector. Call it from the thread which drains.
+        Its usage looks like
+        @code{.cpp}
+            detectorThread->recycle(events);
+            detectorThread->drain(events);
+        @endcode
+    */
+    void recycle(std::vector<Detector::OutputData>& events);
+
+    /*! @brief Tells the detector to stop. Wakes up sleeping threads, so it must not be called from a signal handler.
+    */
     void finish();
 
+    /*! @brief Waits for the detector to stop. Call finish() first.
+    */
+    void join();
+
+    /*! @brief Returns CPU time spent in the detector in ms.
+    */
+    double cpuTime() const noexcept;
+
     bool isRunning() const noexcept;
 
     const std::shared_ptr<Detector> detector() const noexcept;
@@ -155,7 +174,81 @@ public:
 private:
     std::shared_ptr<Detector> m_detector;
     std::shared_ptr<cvt::MetricMaster> m_metrics;
-    bool m_stopDetectorThreads { false };
+    std::atomic<bool> m_stopDetectorThreads { false };
+    std::shared_ptr<DetectorScheduler> m_scheduler;
+    DetectorScheduler::ExecutorPtr m_executor;
+    std::atomic<std::int64_t> m_cpuTimeUs { 0 };
+
+    /* Admission control stuff */
+    AdmissionSettings m_admission;
+    std::int64_t m_lastAdmittedMs { -1 };
+    std::atomic<double> m_latencyMs { 0.0 };
+    std::atomic<std::int64_t> m_staleFrames { 0 };
+    std::atomic<std::int64_t> m_rejectedFrames { 0 };
+    std::atomic<std::int64_t> m_abandonedFrames { 0 };
+    std::atomic<std::int64_t> m_lastProcessedCaptureTime { -1 };
+
+    /* Pipelining stuff */
+    int m_pipelineDepth { 1 };
+    std::unique_ptr<AsyncDetectorRunner> m_runner;
+    Detector::InputData m_heldInput; //!< frame the stages had no room for
+    bool m_inputHeld { false };
+
+    void complete(const Detector::Job& job);
+
+    bool feedRunner();
+
+    /* Batching stuff */
+    int m_batchSize { 1 };
+    std::vector<Detector::InputData> m_batchIn;
+    std::vector<Detector::OutputData> m_batchOut;
+
+    bool processBatch(Detector::InputData&& first);
+
+    /* Snapshot stuff */
+    std::string m_snapshotPath;
+    std::int64_t m_snapshotPeriodMs { 0 };
+    std::int64_t m_lastSnapshotMs { -1 };
+    SnapshotWriter m_snapshotCopy; //!< filled by the detector thread
+    SnapshotWriter m_snapshotPending; //!< handed over to the writer thread
+    bool m_snapshotReady { false };
+    bool m_stopSnapshots { false };
+    std::mutex m_snapshotMutex;
+    std::condition_variable m_snapshotCondition;
+    std::thread m_snapshotThread;
+
+    void snapshotThreadLoop();
+
+    void stopSnapshotThread();
+
+    bool saveState();
+
+    bool restoreState();
+
+    void snapshotIfDue();
+
+    /* Output recycling stuff */
+    SpscQueue<Detector::OutputData> m_spareOutputs; //!< handled outputs on their way back to the detector
+    Detector::OutputData m_output;
+    bool m_outputTaken { false };
+
+    Detector::OutputData& spareOutput();
+
+    bool publish(Detector::OutputData& oData);
+
+    /* Event delivery stuff */
+    std::vector<EventCallback> m_callbacks;
+    std::thread m_sinkThread;
+
+    void sinkThreadLoop();
+
+    void attach();
+
+    bool processOne(std::int64_t waitForMs);
+
+    void dropPending();
+
+    void printSummary() const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <string>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+
+namespace cvt
+{
+
+/*! @brief Returns CPU time consumed by the calling thread in microseconds.
+*/
+std::int64_t threadCpuTimeUs() noexcept;
+
+
+/*! @brief The class runs many detectors on one pool of threads sized to the hardware.
+
+    Every detector gets a serial executor: its work never runs on two threads at once, so a stateful detector
+    sees its frames strictly in order, while different detectors run in parallel.
+    Each worker keeps its own deque of ready executors and steals from the others when it runs dry.
+    Its usage looks like
+    @code{.cpp}
+        auto scheduler = std::make_shared<cvt::DetectorScheduler>();
+        cvt::DetectorThreadManager motion(motionDetector, scheduler);
+        cvt::DetectorThreadManager yolo(objectDetector, scheduler);
+        ...
+        motion.submit(cvt::Detector::InputData(frame));
+        yolo.submit(cvt::Detector::InputData(frame));
+    @endcode
+*/
+class DetectorScheduler final
+{
+public:
+    /*! @brief Serial executor of a single detector.
+    */
+    class Executor final : public std::enable_shared_from_this<Executor>
+    {
+    public:
+        /*! @brief Requests one more run of the work. Runs never overlap.
+        */
+        void notify();
+
+        const std::string& name() const noexcept;
+
+        std::int64_t runs() const noexcept;
+
+        /*! @brief Returns CPU time spent in the work in ms.
+        */
+        double cpuTime() const noexcept;
+
+    private:
+        friend class DetectorScheduler;
+
+        Executor(DetectorScheduler* scheduler, const std::string& name, std::function<void()> work);
+
+        DetectorScheduler* m_scheduler;
+        const std::string m_name;
+        const std::function<void()> m_work;
+        std::atomic<int> m_pending { 0 };
+        std::atomic<bool> m_scheduled { false };
+        std::atomic<bool> m_running { false };
+        std::atomic<bool> m_removed { false };
+        std::atomic<std::int64_t> m_runs { 0 };
+        std::atomic<std::int64_t> m_cpuTimeUs { 0 };
+    };
+
+    using ExecutorPtr = std::shared_ptr<Executor>;
+
+    /*! @param threads number of workers (0 - the detectors share of threadBudget(), otherwise hardware concurrency)
+    */
+    explicit DetectorScheduler(int threads = 0);
+
+    DetectorScheduler(const DetectorScheduler&) = delete;
+
+    DetectorScheduler& operator=(const DetectorScheduler&) = delete;
+
+    ~DetectorScheduler();
+
+    /*! @brief Registers work which is run once per Executor::notify().
+    */
+    ExecutorPtr add(const std::string& name, std::function<void()> work);
+
+    /*! @brief Unregisters the executor. Waits until its current run (if any) is over.
+    */
+    void remove(const ExecutorPtr& executor);
+
+    int threads() const noexcept;
+
+    /*! @brief Returns how many times workers took an executor from another worker's deque.
+    */
+    std::int64_t steals() const noexcept;
+
+    std::string summary() const;
+
+private:
+    struct alignas(64) WorkerQueue
+    {
+        std::deque<ExecutorPtr> executors;
+        std::mutex mutex;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+    std::vector<std::thread> m_workers;
+    std::vector<ExecutorPtr> m_executors;
+    mutable std::mutex m_executorsMutex;
+
+    std::atomic<int> m_queued { 0 };
+    std::atomic<unsigned int> m_nextQueue { 0 };
+    std::atomic<std::int64_t> m_steals { 0 };
+    bool m_stop { false };
+    std::mutex m_mutex;
+    std::condition_variable m_wakeup;
+
+    void schedule(const ExecutorPtr& executor);
+
+    ExecutorPtr take(int workerID);
+
+    void run(const ExecutorPtr& executor, int workerID);
+
+    void workerLoop(int workerID);
+};
+
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <mutex>
+
+#include "frame_pool.hpp"
+#include "detector_manager.hpp"
+
+namespace cvt
+{
+
+/*! @brief The class publishes every frame to several detectors without copying it.
+
+    Subscribers receive the same frame handle, so the pooled buffer returns to its pool only after
+    the slowest of them is done with it. Its usage looks like
+    @code{.cpp}
+        cvt::FrameDispatcher dispatcher;
+        dispatcher.subscribe(*yoloThread);
+        dispatcher.subscribe(*motionThread);
+        while ( ... )
+        {
+            cvt::FrameHandle frame = framePool->acquire(1000);
+            *player >> frame;
+            dispatcher.publish(frame);
+        }
+    @endcode
+    @note publish() must be called from one thread, the subscribers' input queues are single-producer.
+*/
+class FrameDispatcher final
+{
+public:
+    struct SubscriberStats
+    {
+        std::int64_t published { 0 }; //!< frames offered to the subscriber
+        std::int64_t admitted { 0 }; //!< frames the subscriber accepted
+        int queued { 0 }; //!< frames waiting in the subscriber's queue
+        std::int64_t lagMs { 0 }; //!< capture time of the last published frame minus that of the last processed one
+    };
+
+    FrameDispatcher() = default;
+
+    ~FrameDispatcher() = default;
+
+    /*! @brief Adds the detector. It must stay alive until it is unsubscribed or the dispatcher is destroyed.
+
+        @return subscriber id
+    */
+    int subscribe(DetectorThreadManager& manager);
+
+    void unsubscribe(int id);
+
+    /*! @brief Hands the frame to every subscriber.
+
+        @return number of subscribers which accepted the frame
+    */
+    int publish(const FrameHandle& frame);
+
+    int subscribers() const;
+
+    SubscriberStats stats(int id) const;
+
+    /*! @brief Returns id of the subscriber lagging behind the most or -1 if there are no subscribers.
+    */
+    int slowestSubscriber() const;
+
+    std::string summary() const;
+
+private:
+    struct Subscriber
+    {
+        int id;
+        DetectorThreadManager* manager;
+        std::int64_t published { 0 };
+        std::int64_t admitted { 0 };
+    };
+
+    std::vector<Subscriber> m_subscribers;
+    int m_nextID { 0 };
+    std::int64_t m_lastCaptureTime { -1 };
+    mutable std::mutex m_mutex;
+
+    SubscriberStats makeStats(const Subscriber& subscriber) const;
+};
+
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core.hpp>
+
+#include "ingest.hpp"
+
+namespace cvt
+{
+
+/*! @brief The struct for a pooled frame buffer.
+*/
+struct Frame
+{
+    cv::Mat image;
+    std::int64_t timestamp { -1 };
+    std::int64_t captureTime { -1 }; //!< steady clock time (ms) the frame was captured at
+    int frameNum { -1 };
+    bool keyframe { false };
+    FramePlanes planes; //!< (optional) downscaled representations shared by all consumers
+};
+
+/*! @brief Reference-counted handle to a pooled frame.
+
+    The underlying buffer goes back to its pool when the last handle is released.
+*/
+using FrameHandle = std::shared_ptr<Frame>;
+
+
+/*! @brief The class hands out fixed-size, reference-counted frame buffers.
+
+    One decoded frame can be shared between any number of consumers (e.g. detector threads) without copying.
+    Buffers are allocated lazily up to capacity and recycled only after the last consumer releases them.
+    The pool must be owned by std::shared_ptr. Its usage looks like
+    @code{.cpp}
+        auto pool = std::make_shared<cvt::FramePool>(player->frame0().size(), player->frame0().type());
+
+        cvt::FrameHandle frame = pool->acquire();
+        *player >> frame;
+        detectorThread->iDataQueue.push(cvt::Detector::InputData(frame));
+    @endcode
+*/
+class FramePool final : public std::enable_shared_from_this<FramePool>
+{
+public:
+    FramePool(cv::Size size, int type, int capacity = 16);
+
+    FramePool(const FramePool&) = delete;
+
+    FramePool& operator=(const FramePool&) = delete;
+
+    ~FramePool() = default;
+
+    /*! @brief Takes a free buffer from the pool.
+
+        @param waitForMs how long to wait for a buffer if all of them are in use
+
+        @return frame handle or nullptr if the pool is exhausted
+    */
+    FrameHandle acquire(std::int64_t waitForMs = 0);
+
+    cv::Size size() const noexcept;
+
+    int type() const noexcept;
+
+    int capacity() const noexcept;
+
+    /*! @brief Returns the number of buffers currently handed out.
+    */
+    int inUse() const;
+
+    /*! @brief Returns the size of a single buffer in bytes.
+    */
+    std::size_t frameBytes() const noexcept;
+
+    /*! @brief Returns the peak number of simultaneously used buffers.
+    */
+    int highWaterFrames() const;
+
+    /*! @brief Returns the peak amount of memory in simultaneous use, in bytes.
+    */
+    std::size_t highWaterMark() const;
+
+    std::string summary() const;
+
+private:
+    const cv::Size m_size;
+    const int m_type;
+    const int m_capacity;
+    std::vector<std::unique_ptr<Frame>> m_free;
+    int m_allocated { 0 };
+    int m_inUse { 0 };
+    int m_highWater { 0 };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+
+    void release(Frame* frame);
+};
+
+}
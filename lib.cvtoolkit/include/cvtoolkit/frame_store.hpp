@@ -0,0 +1,117 @@
+#pragma once
+
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include <opencv2/core.hpp>
+
+namespace cvt
+{
+
+/*! @brief Index record of one stored frame.
+*/
+struct FrameStoreEntry
+{
+    std::uint64_t offset; //!< byte offset of the frame in the data file
+    std::int64_t timestamp; //!< ms
+    std::int32_t rows;
+    std::int32_t cols;
+    std::int32_t type;
+    std::uint32_t bytes;
+};
+
+
+/*! @brief The class records frames into a raw frame store.
+
+    The store consists of a data file with uncompressed, 64-byte aligned frames and an index file
+    (data file name + ".idx") of offsets, timestamps and sizes. Its usage looks like
+    @code{.cpp}
+        cvt::FrameStoreWriter store("footage.cvr", player->fps());
+        while ( ... )
+        {
+            *player >> frame;
+            store.write(frame, player->timestamp());
+        }
+    @endcode
+    Then "footage.cvr" can be given to OpenCVPlayer as an input.
+*/
+class FrameStoreWriter final
+{
+public:
+    FrameStoreWriter() = default;
+
+    FrameStoreWriter(const std::string& path, double fps);
+
+    ~FrameStoreWriter();
+
+    bool open(const std::string& path, double fps);
+
+    bool write(const cv::Mat& frame, std::int64_t timestamp);
+
+    void release();
+
+    bool isOpened() const noexcept;
+
+    int frames() const noexcept;
+
+private:
+    std::ofstream m_data;
+    std::ofstream m_index;
+    std::uint64_t m_offset { 0 };
+    int m_frames { 0 };
+};
+
+
+/*! @brief The class replays a raw frame store through a read-only memory mapping.
+
+    Replay costs a page-cache read instead of decoding, and several processes replaying
+    the same store share its pages. The mapping is private, so writing into a returned
+    frame copies the touched pages instead of altering the store.
+*/
+class FrameStoreReader final
+{
+public:
+    FrameStoreReader() = default;
+
+    explicit FrameStoreReader(const std::string& path);
+
+    FrameStoreReader(const FrameStoreReader&) = delete;
+
+    FrameStoreReader& operator=(const FrameStoreReader&) = delete;
+
+    ~FrameStoreReader();
+
+    bool open(const std::string& path);
+
+    void release();
+
+    bool isOpened() const noexcept;
+
+    int frames() const noexcept;
+
+    double fps() const noexcept;
+
+    /*! @brief Returns a header over the mapped frame without copying or an empty matrix if out of range.
+
+        The matrix is valid while the reader is open.
+    */
+    cv::Mat frame(int frameNum) const;
+
+    std::int64_t timestamp(int frameNum) const;
+
+    static std::string indexPath(const std::string& path);
+
+private:
+    std::vector<FrameStoreEntry> m_entries;
+    double m_fps { 0.0 };
+    uchar* m_data { nullptr };
+    std::size_t m_dataSize { 0 };
+#ifdef _WIN32
+    void* m_file { nullptr };
+    void* m_mapping { nullptr };
+#endif
+};
+
+}
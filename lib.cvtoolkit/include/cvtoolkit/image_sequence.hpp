@@ -0,0 +1,114 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/imgcodecs.hpp>
+
+namespace cvt
+{
+
+/*! @brief The class reads a folder (or a glob pattern) of images in name order.
+
+    Images are decoded by a pool of workers ahead of consumption, so reading runs at the throughput
+    of all cores rather than of a single cv::imread. Frames are still handed out strictly in order.
+    Its usage looks like
+    @code{.cpp}
+        cvt::ImageSequenceReader sequence("snapshots/*.jpg");
+        cv::Mat frame;
+        while ( sequence.read(frame) )
+        {
+            // ...
+        }
+    @endcode
+*/
+class ImageSequenceReader final
+{
+public:
+    /*! @brief Lists the images and starts decoding.
+
+        @param pattern directory or glob pattern
+        @param size (optional) size every image is resized to
+        @param scaleFactor (optional) scale every image is resized with if size is empty
+        @param decodeThreads number of workers (0 - hardware concurrency)
+        @param lookahead max number of decoded frames waiting to be read (0 - twice the number of workers)
+    */
+    ImageSequenceReader(const std::string& pattern, cv::Size size = cv::Size(), double scaleFactor = 1.0,
+                        int decodeThreads = 0, int lookahead = 0);
+
+    ImageSequenceReader(const ImageSequenceReader&) = delete;
+
+    ImageSequenceReader& operator=(const ImageSequenceReader&) = delete;
+
+    ~ImageSequenceReader();
+
+    /*! @brief Says whether the input is a directory or a glob pattern.
+    */
+    static bool isSequence(const std::string& input);
+
+    bool isOpened() const noexcept;
+
+    int frames() const noexcept;
+
+    /*! @brief Reads the next image. Blocks until it is decoded.
+
+        Files which cannot be decoded are skipped (and logged), so a damaged image does not end the sequence.
+
+        @return false if there are no more images
+    */
+    bool read(cv::Mat& out);
+
+    /*! @brief Returns the number of the next image to read, skipped files included.
+    */
+    int position() const;
+
+    /*! @brief Moves to the given image. Frames decoded ahead are dropped.
+    */
+    void seek(int frameNum);
+
+    /*! @brief Makes timestamps follow the given rate instead of file modification times.
+
+        @param fps frame rate (0 - use modification times)
+    */
+    void setFrameRate(double fps);
+
+    /*! @brief Returns image timestamp in ms counted from the first image.
+    */
+    std::int64_t timestamp(int frameNum) const;
+
+    const std::string& path(int frameNum) const;
+
+private:
+    struct Slot
+    {
+        int frameNum { -1 };
+        cv::Mat image;
+        bool skipped { false }; //!< the file could not be decoded
+    };
+
+    std::vector<std::string> m_paths;
+    std::vector<std::int64_t> m_mtimes;
+    const cv::Size m_size;
+    const double m_scaleFactor { 1.0 };
+    double m_fps { 0.0 };
+
+    std::vector<std::thread> m_workers;
+    std::vector<Slot> m_slots;
+    int m_next { 0 }; //!< next frame to read
+    int m_dispatched { 0 }; //!< next frame to decode
+    int m_epoch { 0 }; //!< increments on seek, so that stale decodes are discarded
+    bool m_stop { false };
+    mutable std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::condition_variable m_space;
+
+    void workerLoop();
+};
+
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+namespace cvt
+{
+
+/*! @brief Describes a frame representation required by a detector.
+*/
+struct PlaneSpec
+{
+    enum Format
+    {
+        GRAY, //!< 8-bit single-channel
+        BGR //!< 8-bit 3-channel
+    };
+
+    int format { Format::BGR };
+    cv::Size size;
+
+    bool operator==(const PlaneSpec& other) const noexcept
+    {
+        return format == other.format && size == other.size;
+    }
+};
+
+using PlaneSpecs = std::vector<PlaneSpec>;
+
+
+/*! @brief The set of frame representations produced by IngestStage.
+
+    Buffers survive clear(), so a recycled frame does not reallocate them.
+*/
+struct FramePlanes
+{
+    PlaneSpecs specs;
+    std::vector<cv::Mat> planes;
+
+    /*! @brief Returns requested plane or nullptr if it has not been produced.
+    */
+    const cv::Mat* find(const PlaneSpec& spec) const noexcept
+    {
+        for ( size_t i = 0; i < specs.size(); ++i )
+        {
+            if ( specs[i] == spec )
+            {
+                return &planes[i];
+            }
+        }
+        return nullptr;
+    }
+
+    const cv::Mat* find(int format, cv::Size size) const noexcept
+    {
+        return find(PlaneSpec{ format, size });
+    }
+
+    void clear() noexcept
+    {
+        specs.clear();
+    }
+};
+
+
+/*! @brief The class produces all frame representations required by detectors.
+
+    Downscaled planes of the same size are computed in one row-parallel pass which reads every source pixel once
+    and box-averages it into both BGR and gray outputs. The filter uses whole-pixel footprints, so it is close to
+    cv::INTER_AREA followed by cv::cvtColor, and the same when the source size is an integer multiple of the plane
+    size. With fractional ratios INTER_AREA also weights the pixels on footprint edges, which is not done here.
+    Its usage looks like
+    @code{.cpp}
+        cvt::IngestStage ingest;
+        ingest.require(detector->requiredPlanes());
+
+        *player >> frame;
+        ingest.process(frame->image, frame->planes);
+    @endcode
+*/
+class IngestStage final
+{
+public:
+    IngestStage(const PlaneSpecs& specs = PlaneSpecs());
+
+    ~IngestStage() = default;
+
+    /*! @brief Adds plane to the set of produced planes. Duplicates are ignored.
+    */
+    void require(const PlaneSpec& spec);
+
+    void require(const PlaneSpecs& specs);
+
+    const PlaneSpecs& specs() const noexcept;
+
+    bool empty() const noexcept;
+
+    /*! @brief Produces all required planes.
+
+        Footprints and accumulators are kept between calls, so in steady state the call allocates nothing.
+
+        @param src source frame (CV_8UC3 or CV_8UC1)
+        @param out output planes
+    */
+    void process(const cv::Mat& src, FramePlanes& out);
+
+private:
+    /* Planes of one size, produced in one pass */
+    struct Group
+    {
+        cv::Size size;
+        int bgr { -1 }; //!< index of the BGR plane in m_specs
+        int gray { -1 }; //!< index of the gray plane in m_specs
+        cv::Size srcSize; //!< source size the footprints were made for
+        std::vector<int> xofs;
+        std::vector<int> yofs;
+    };
+
+    PlaneSpecs m_specs;
+    std::vector<Group> m_groups;
+    std::vector<std::vector<int>> m_stripeAcc; //!< accumulator row of every stripe of the downscale pass
+};
+
+}
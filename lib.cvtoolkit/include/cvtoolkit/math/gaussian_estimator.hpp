@@ -76,6 +76,15 @@ public:
         return m_sigma2;
     }
 
+
+    /*! @brief Restores estimations obtained earlier (e.g. before a restart).
+    */
+    void restore(double mu, double sigma2) noexcept
+    {
+        m_mu = mu;
+        m_sigma2 = sigma2;
+    }
+
 private:
     double m_alpha { 1.0 / 100 };
     double m_mu { 0.0 };
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+#include <opencv2/core.hpp>
+
+#include "cvplayer.hpp"
+#include "frame_pool.hpp"
+#include "concurrent_queue.hpp"
+
+namespace cvt
+{
+
+/*! @brief The class captures many inputs (files, RTSP, webcams) in one process.
+
+    All streams are decoded by a shared pool of threads which visit them in round-robin order,
+    so one slow stream can not starve the others. Decoded frames are tagged with stream id and
+    timestamp and delivered to a single consumer. Its usage looks like
+    @code{.cpp}
+        cvt::MultiSourcePlayer players({"rtsp://cam1", "rtsp://cam2", "video.mp4"}, cv::Size(640, 360));
+        players.start();
+
+        cvt::MultiSourcePlayer::StreamFrame item;
+        while ( players.read(item, 1000) )
+        {
+            // item.streamId, item.timestamp, item.frame->image
+        }
+    @endcode
+*/
+class MultiSourcePlayer final
+{
+public:
+
+    struct StreamFrame
+    {
+        int streamId { -1 };
+        std::int64_t timestamp { -1 };
+        FrameHandle frame;
+    };
+
+    struct StreamStats
+    {
+        std::string input;
+        std::int64_t frames { 0 }; //!< frames delivered to the consumer
+        std::int64_t dropped { 0 }; //!< live frames skipped because the consumer fell behind
+        double fps { 0.0 }; //!< measured delivery rate
+        bool finished { false };
+    };
+
+    /*! @brief Constructor.
+
+        @param inputs list of inputs accepted by OpenCVPlayer
+        @param inputSize desired frame size. If empty, native resolution is kept
+        @param decodeThreads number of decode threads. If 0, it is chosen from the hardware concurrency
+        @param maxPendingFrames maximum number of frames per stream waiting for the consumer
+    */
+    MultiSourcePlayer(const std::vector<std::string>& inputs, cv::Size inputSize = cv::Size(), 
+                        int decodeThreads = 0, int maxPendingFrames = 4);
+
+    MultiSourcePlayer(const MultiSourcePlayer&) = delete;
+
+    MultiSourcePlayer& operator=(const MultiSourcePlayer&) = delete;
+
+    ~MultiSourcePlayer();
+
+    void start();
+
+    void stop();
+
+    /*! @brief Takes the next decoded frame of any stream.
+
+        @param out output frame
+        @param waitForMs how long to wait for a frame
+
+        @return false if no frame arrived in time
+    */
+    bool read(StreamFrame& out, std::int64_t waitForMs);
+
+    int streams() const noexcept;
+
+    /*! @brief Says whether all streams have ended and every frame has been read.
+    */
+    bool finished() const;
+
+    StreamStats stats(int streamId) const;
+
+    std::string summary() const;
+
+    const std::shared_ptr<OpenCVPlayer>& player(int streamId) const;
+
+private:
+
+    struct Stream
+    {
+        std::shared_ptr<OpenCVPlayer> player;
+        std::shared_ptr<FramePool> pool;
+        bool live { false };
+        std::atomic<bool> busy { false };
+        std::atomic<int> pending { 0 };
+        std::atomic<bool> finished { false };
+        StreamStats stats;
+        std::int64_t lastDeliveryTick { -1 };
+    };
+
+    std::vector<std::unique_ptr<Stream>> m_streams;
+    std::vector<std::thread> m_workers;
+    ConcurrentQueue<StreamFrame> m_queue;
+    const int m_decodeThreads;
+    const int m_maxPendingFrames;
+    std::atomic<unsigned int> m_cursor { 0 };
+    std::atomic<bool> m_running { false };
+    mutable std::mutex m_statsMutex;
+    std::mutex m_idleMutex;
+    std::condition_variable m_idleCondition;
+
+    void workerLoop();
+
+    bool serve(Stream& stream, int streamId);
+};
+
+}
@@ -2,6 +2,8 @@
 
 #include <iostream>
 #include <map>
+#include <vector>
+#include <string_view>
 #include <opencv2/dnn.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
@@ -34,6 +36,16 @@ public:
 
 protected:
     cv::dnn::Net m_net;
+    std::vector<std::string_view> m_classNames; //!< interned class names indexed by class id
+
+    /*! @brief Interns class names once, so that naming a detection costs an index lookup.
+    */
+    void internClassNames( const ObjectClasses& classes );
+
+    std::string_view className( int classId ) const noexcept
+    {
+        return ( classId >= 0 && classId < static_cast<int>(m_classNames.size()) ) ? m_classNames[classId] : std::string_view();
+    }
 };
 
 
@@ -59,6 +71,24 @@ public:
     virtual void Infer( const cv::Mat& frame, InferOuts& out, 
                         float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() ) = 0;
 
+    /*! @brief Performes model inference on several frames at once.
+
+        The default implementation calls Infer() for every frame. Detectors which can stack frames
+        into one blob override it to run a single forward pass.
+
+        @param frames input frames
+        @param outs output structures, one per frame
+    */
+    virtual void InferBatch( const std::vector<cv::Mat>& frames, std::vector<InferOuts>& outs, 
+                             float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() )
+    {
+        outs.resize(frames.size());
+        for ( size_t i = 0; i < frames.size(); ++i )
+        {
+            Infer( frames[i], outs[i], confThreshold, acceptedClasses );
+        }
+    }
+
 
     /*! @brief Performes model output filtration.
 
@@ -107,7 +137,7 @@ public:
     */
     virtual const ObjectClasses& objectClasses() const noexcept;
 
-    virtual inline std::string getClassName( int classId );
+    virtual inline std::string_view getClassName( int classId );
 
 protected:
     ObjectClasses m_objectClasses;
@@ -146,7 +176,7 @@ private:
     void postprocess( const cv::Mat& frame, const std::vector<cv::Mat>& outs, 
                 InferOuts& inferOuts, float confThreshold = 0.25f, const ObjectClasses& acceptedClasses = ObjectClasses() );
 
-    inline std::string getClassName( int classId );
+    inline std::string_view getClassName( int classId );
 };
 
 
@@ -163,10 +193,44 @@ public:
     void Infer( const cv::Mat& frame, InferOuts& out, 
                 float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() ) override;
 
+    /*! @brief Stacks the frames into one blob and runs a single forward pass.
+    */
+    void InferBatch( const std::vector<cv::Mat>& frames, std::vector<InferOuts>& outs, 
+                     float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() ) override;
+
     void Filter( const InferOuts& in, InferOuts& out, const ObjectClasses& acceptedClasses ) override;
 
     const ObjectClasses& yoloObjectClasses() const noexcept;
 
+    /*! @brief Makes the network input from the frame. Infer() is Preprocess(), Forward() and Postprocess() in a row.
+
+        The stages share no mutable state, so they may run concurrently on different frames.
+    */
+    void Preprocess( const cv::Mat& frame, cv::Mat& blob ) const;
+
+    /*! @brief Runs the network.
+    */
+    void Forward( const cv::Mat& blob, std::vector<cv::Mat>& outs );
+
+    /*! @brief Decodes the network output and applies NMS.
+
+        @param frameSize size of the frame boxes are mapped to
+    */
+    void Postprocess( cv::Size frameSize, const std::vector<cv::Mat>& outs, InferOuts& inferOuts, 
+                      float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() ) const;
+
+    /*! @brief Stacks the frames into one network input. InferBatch() is PreprocessBatch(), Forward() and PostprocessBatch().
+    */
+    void PreprocessBatch( const std::vector<cv::Mat>& frames, cv::Mat& blob ) const;
+
+    /*! @brief Splits the batched network output per frame, then decodes it and applies NMS.
+
+        @param frameSizes sizes of the frames boxes are mapped to, one per frame in the batch
+    */
+    void PostprocessBatch( const std::vector<cv::Size>& frameSizes, const std::vector<cv::Mat>& outs, 
+                           std::vector<InferOuts>& inferOuts, 
+                           float confThreshold = DEFAULT_CONF, const ObjectClasses& acceptedClasses = ObjectClasses() ) const;
+
 protected:
     void readObjectClasses( const std::string& classPath ) override;
 
@@ -174,12 +238,7 @@ private:
     std::vector<cv::String> m_outNames;
     std::vector<int> m_outLayers;
 
-    inline void preprocess( const cv::Mat& frame );
-
-    void postprocess( const cv::Mat& frame, const std::vector<cv::Mat>& outs, 
-                InferOuts& inferOuts, float confThreshold = 0.25f, const ObjectClasses& acceptedClasses = ObjectClasses() );
-
-    inline std::string getClassName( int classId );
+    std::string_view getClassName( int classId ) const;
 };
 
 }
\ No newline at end of file
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <functional>
+
+#include <opencv2/core.hpp>
+
+#include "frame_pool.hpp"
+#include "detector.hpp"
+#include "spsc_queue.hpp"
+
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+
+namespace cvt
+{
+
+/*! @brief The unit of data flowing between pipeline stages.
+
+    Items are cheap to copy: the frame is a pooled handle and the canvas shares its buffer.
+*/
+struct PipelineItem
+{
+    FrameHandle frame;
+    std::vector<Detector::OutputData> events; //!< events found by upstream detectors
+    cv::Mat canvas; //!< (optional) frame prepared for display or recording
+};
+
+
+/*! @brief Describes the stream a stage emits.
+*/
+struct StreamInfo
+{
+    cv::Size size;
+    int type { CV_8UC3 };
+    double fps { 0.0 };
+};
+
+
+/*! @brief The base class for all pipeline stages.
+
+    Every stage runs on its own thread and gets items from its parent through a bounded queue.
+*/
+class PipelineStage
+{
+public:
+    virtual ~PipelineStage() = default;
+
+    /*! @brief Handles the item in place.
+
+        A source fills the item and returns false at the end of the stream.
+        Any other stage returns false to drop the item instead of passing it downstream.
+    */
+    virtual bool process(PipelineItem& item) = 0;
+
+    /*! @brief Returns true if the stage produces items rather than consumes them.
+    */
+    virtual bool isSource() const
+    {
+        return false;
+    }
+
+    /*! @brief Returns the stream the stage emits given the one it receives.
+    */
+    virtual StreamInfo streamInfo(const StreamInfo& upstream) const
+    {
+        return upstream;
+    }
+
+    /*! @brief Returns frame representations the stage consumes (see Detector::requiredPlanes()).
+    */
+    virtual PlaneSpecs requiredPlanes() const
+    {
+        return PlaneSpecs();
+    }
+
+    /*! @brief Tells the stage which planes the stages below it consume.
+    */
+    virtual void connect(const PlaneSpecs& downstream)
+    {
+    }
+
+    /*! @brief Called on the stage thread after the last item.
+    */
+    virtual void finish()
+    {
+    }
+
+protected:
+    bool stopRequested() const noexcept;
+
+    /*! @brief Stops the whole pipeline (e.g. the display window was closed).
+    */
+    void requestStop() noexcept;
+
+private:
+    friend class Pipeline;
+    std::atomic<bool>* m_stop { nullptr };
+};
+
+
+/*! @brief The class builds a graph of stages from JSON and runs it.
+
+    Every stage names its parent with "from", so the graph is a tree rooted at sources: a stage can feed any number
+    of stages, each of which gets its own copy of the item. Stages are connected with bounded queues whose size and
+    overflow policy ("block" or "drop-oldest") are set per stage. The description looks like
+    @code{.json}
+        "pipeline" :
+        {
+            "stages" :
+            [
+                { "name" : "camera", "type" : "source", "input" : "0" },
+                { "name" : "ingest", "type" : "preprocess", "from" : "camera" },
+                { "name" : "motion", "type" : "detector", "from" : "ingest", "queue-policy" : "drop-oldest",
+                  "detector" : "optflow-motion-detector", "settings" : "motion.json" },
+                { "name" : "render", "type" : "render", "from" : "motion" },
+                { "name" : "window", "type" : "display", "from" : "render" }
+            ]
+        }
+    @endcode
+    and its usage looks like
+    @code{.cpp}
+        cvt::Pipeline pipeline;
+        if ( pipeline.load("pipeline.json") && pipeline.start() )
+        {
+            pipeline.wait();
+        }
+        std::cout << pipeline.summary() << std::endl;
+    @endcode
+*/
+class Pipeline final
+{
+public:
+    enum QueuePolicy
+    {
+        BLOCK, //!< the parent waits for room in the queue
+        DROP_OLDEST //!< the oldest queued item is dropped
+    };
+
+    struct StageStats
+    {
+        std::string name;
+        std::string type;
+        std::int64_t processed { 0 }; //!< items handled by the stage
+        double fps { 0.0 }; //!< average (EMA) throughput
+        double busyMs { 0.0 }; //!< average (EMA) time spent in process()
+        int queueDepth { 0 }; //!< items waiting in the input queue
+        int queueCapacity { 0 };
+        std::int64_t dropped { 0 }; //!< items dropped by the input queue
+    };
+
+    using StageCreator = std::function<std::unique_ptr<PipelineStage>(const json& params, const StreamInfo& upstream)>;
+
+    using DetectorCreator = std::function<std::shared_ptr<Detector>(const Detector::InitializeData& iData)>;
+
+    Pipeline() = default;
+
+    Pipeline(const Pipeline&) = delete;
+
+    Pipeline& operator=(const Pipeline&) = delete;
+
+    ~Pipeline();
+
+    /*! @brief Makes a stage type available to "type". Built-in types are
+        "source", "preprocess", "detector", "render", "display", "record" and "log".
+    */
+    static void registerStage(const std::string& type, StageCreator creator);
+
+    /*! @brief Makes a detector available to "detector" stages. Built-in detectors are
+        "yolo-object-detector" and "optflow-motion-detector".
+    */
+    static void registerDetector(const std::string& name, DetectorCreator creator);
+
+    static std::shared_ptr<Detector> createDetector(const std::string& name, const Detector::InitializeData& iData);
+
+    /*! @brief Builds the pipeline from the JSON file.
+    */
+    bool load(const std::string& jPath, const std::string& nodeName = "pipeline");
+
+    /*! @brief Builds the pipeline from its description (an object with a "stages" array).
+    */
+    bool build(const json& j);
+
+    bool start();
+
+    /*! @brief Asks all stages to stop. Queued items are discarded.
+    */
+    void stop();
+
+    /*! @brief Waits until all stages are finished.
+    */
+    void wait();
+
+    bool running() const noexcept;
+
+    std::vector<StageStats> stats() const;
+
+    std::string summary() const;
+
+private:
+    struct Node
+    {
+        std::string name;
+        std::string type;
+        int parent { -1 };
+        std::vector<int> children;
+        std::unique_ptr<PipelineStage> stage;
+        std::unique_ptr<SpscQueue<PipelineItem>> queue; //!< input queue, null for sources
+        int policy { QueuePolicy::BLOCK };
+        std::thread thread;
+        std::atomic<bool> done { false };
+        std::atomic<std::int64_t> processed { 0 };
+        std::atomic<double> fps { 0.0 };
+        std::atomic<double> busyMs { 0.0 };
+    };
+
+    std::vector<std::unique_ptr<Node>> m_nodes; //!< parents always precede their children
+    std::atomic<bool> m_stop { false };
+    bool m_started { false };
+
+    void stageLoop(Node& node);
+
+    void forward(Node& node, PipelineItem&& item);
+
+    PlaneSpecs descendantPlanes(const Node& node) const;
+};
+
+}
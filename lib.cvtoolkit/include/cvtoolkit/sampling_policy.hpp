@@ -0,0 +1,100 @@
+#pragma once
+
+#include <iostream>
+#include <atomic>
+#include <string>
+
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+
+namespace cvt
+{
+
+/*! @brief Settings of the temporal sampling of a detector.
+
+    They are read from the "sampling" node of the detector settings:
+    @code{.json}
+        "sampling" :
+        {
+            "policy" : "activity",
+            "period-ms" : 100,
+            "idle-period-ms" : 1000,
+            "active-hold-ms" : 3000
+        }
+    @endcode
+    Without the node the detector samples at a fixed "process-freq-ms" rate.
+*/
+struct SamplingSettings
+{
+    enum Policy
+    {
+        FIXED, //!< "fixed": one frame per period
+        ACTIVITY, //!< "activity": one frame per period while events are on, one per idle period otherwise
+        KEYFRAME //!< "keyframe": keyframes only, plus one frame per period (1 s if unset) if keyframes are far apart
+    };
+
+    int policy { Policy::FIXED };
+    std::int64_t periodMs { 0 }; //!< 0 - every frame
+    std::int64_t idlePeriodMs { 1000 };
+    std::int64_t activeHoldMs { 3000 }; //!< events stay on this long after the last one
+
+    /*! @param j "sampling" node
+        @param periodMs period used if the node does not set it
+    */
+    static SamplingSettings fromJson(json j, std::int64_t periodMs = 0);
+};
+
+
+/*! @brief The class decides which frames a detector processes.
+
+    admit() and observe() may be called from different threads (e.g. the first and the last stage of a
+    pipelined detector), but admit() itself from one thread at a time. Its usage looks like
+    @code{.cpp}
+        cvt::SamplingPolicy sampling(settings->sampling());
+        ...
+        if ( !sampling.admit(in.timestamp, in.keyframe) )
+            return;
+        ...
+        sampling.observe(in.timestamp, out.event);
+    @endcode
+*/
+class SamplingPolicy final
+{
+public:
+    explicit SamplingPolicy(const SamplingSettings& settings = SamplingSettings());
+
+    /*! @brief Says whether the frame should be processed.
+
+        @param timestamp frame timestamp (ms)
+        @param keyframe whether the frame is a keyframe (see OpenCVPlayer::isKeyframe())
+    */
+    bool admit(std::int64_t timestamp, bool keyframe = false);
+
+    /*! @brief Feeds the detector result back to activity-driven sampling.
+    */
+    void observe(std::int64_t timestamp, bool event) noexcept;
+
+    /*! @brief Says whether events are on at the given time.
+    */
+    bool active(std::int64_t timestamp) const noexcept;
+
+    const SamplingSettings& settings() const noexcept;
+
+    std::int64_t admitted() const noexcept;
+
+    std::int64_t skipped() const noexcept;
+
+    std::string summary() const;
+
+private:
+    SamplingSettings m_settings;
+    std::int64_t m_lastAdmittedMs { -1 };
+    std::atomic<std::int64_t> m_lastEventMs { -1 };
+    std::atomic<std::int64_t> m_admitted { 0 };
+    std::atomic<std::int64_t> m_skipped { 0 };
+
+    bool periodElapsed(std::int64_t timestamp, std::int64_t periodMs);
+};
+
+}
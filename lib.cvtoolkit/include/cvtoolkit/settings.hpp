@@ -9,6 +9,8 @@ using json = nlohmann::json;
 
 #include "logger.hpp"
 #include "types.hpp"
+#include "video_writer.hpp"
+#include "thread_budget.hpp"
 #include "nn/nn.hpp"
 
 namespace cvt
@@ -34,10 +36,18 @@ public:
 
     bool record() const noexcept;
 
+    /*! @brief Returns recording parameters ("record-path", "record-codec", "record-policy", "record-queue-size").
+    */
+    const AsyncVideoWriter::Params& recordParams() const noexcept;
+
     bool display() const noexcept;
 
     bool gpu() const noexcept;
 
+    /*! @brief Returns the thread layout from "thread-budget" (empty if there is none), see setThreadBudget().
+    */
+    const ThreadBudget& threadBudget() const noexcept;
+
     inline bool initialize() const noexcept { return m_initialize; }
 
 protected:
@@ -50,8 +60,10 @@ private:
     std::string m_input { "0" };
     cv::Size m_inputSize { 640, 360 };
     bool m_record { false };
+    AsyncVideoWriter::Params m_recordParams;
     bool m_display { true };
     bool m_gpu { false };
+    ThreadBudget m_threadBudget;
     Areas m_areas;
 };
 
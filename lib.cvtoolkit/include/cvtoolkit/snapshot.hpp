@@ -0,0 +1,108 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstring>
+#include <type_traits>
+
+#include <opencv2/core.hpp>
+
+namespace cvt
+{
+
+/*! @brief The class packs learned state into a compact binary blob.
+
+    Values are written as they lie in memory, so a snapshot is meant to be read back on the same platform.
+    Its usage looks like
+    @code{.cpp}
+        cvt::SnapshotWriter snapshot;
+        snapshot.write(m_mean);
+        snapshot.write(m_background);
+        cvt::saveSnapshot("camera1.snap", snapshot);
+    @endcode
+*/
+class SnapshotWriter final
+{
+public:
+    template <typename T>
+    void write(const T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be written as they are");
+        const char* bytes = reinterpret_cast<const char*>(&value);
+        m_data.insert(m_data.end(), bytes, bytes + sizeof(T));
+    }
+
+    void write(const cv::Mat& mat);
+
+    void write(const std::string& str);
+
+    /*! @brief Nests another snapshot, e.g. one of a wrapped detector.
+    */
+    void write(const SnapshotWriter& nested);
+
+    const std::vector<char>& data() const noexcept;
+
+    void clear() noexcept;
+
+private:
+    std::vector<char> m_data;
+};
+
+
+/*! @brief The class reads values back in the order SnapshotWriter wrote them.
+
+    A read past the end or of a malformed value fails and fails all further reads, so it is enough
+    to check good() once at the end.
+*/
+class SnapshotReader final
+{
+public:
+    SnapshotReader() = default;
+
+    explicit SnapshotReader(std::vector<char> data);
+
+    template <typename T>
+    bool read(T& value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "only plain values can be read as they are");
+        if ( !m_good || m_pos + sizeof(T) > m_data.size() )
+        {
+            m_good = false;
+            return false;
+        }
+        std::memcpy(&value, m_data.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+        return true;
+    }
+
+    bool read(cv::Mat& mat);
+
+    bool read(std::string& str);
+
+    bool read(SnapshotReader& nested);
+
+    bool good() const noexcept;
+
+    bool atEnd() const noexcept;
+
+private:
+    std::vector<char> m_data;
+    std::size_t m_pos { 0 };
+    bool m_good { true };
+};
+
+
+/*! @brief Writes the snapshot into a file.
+
+    The file is replaced atomically, so a crash while saving leaves the previous snapshot intact.
+*/
+bool saveSnapshot(const std::string& path, const SnapshotWriter& snapshot);
+
+/*! @brief Reads the snapshot from a file.
+
+    @return false if the file is missing, foreign or damaged
+*/
+bool loadSnapshot(const std::string& path, SnapshotReader& snapshot);
+
+}
@@ -0,0 +1,310 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+
+namespace cvt
+{
+
+/*! @brief Bounded single-producer/single-consumer ring buffer.
+
+    push() and tryPop() never lock: every slot carries a sequence number telling whose turn it is,
+    and producer and consumer positions live on separate cache lines. A consumer sleeps on a condition variable
+    only when the ring is empty, and the producer touches the mutex only when someone is actually sleeping.
+    When the ring is full, the newest item is either rejected or replaces the oldest one. Its usage looks like
+    @code{.cpp}
+        cvt::SpscQueue<cvt::Detector::InputData> queue(64, cvt::SpscQueue<cvt::Detector::InputData>::OVERWRITE_OLDEST);
+
+        // producer
+        queue.push(std::move(iData));
+
+        // consumer
+        cvt::Detector::InputData iData;
+        if ( queue.pop1(iData, 1000) ) { ... }
+    @endcode
+*/
+template<typename T>
+class SpscQueue final
+{
+public:
+    enum Policy
+    {
+        REJECT_NEWEST, //!< push() fails if the ring is full
+        OVERWRITE_OLDEST //!< push() drops the oldest item if the ring is full
+    };
+
+    /*! @param capacity max number of items, rounded up to a power of two
+        @param policy what to do if the ring is full
+    */
+    explicit SpscQueue(int capacity = 64, int policy = Policy::REJECT_NEWEST)
+        : m_policy(policy)
+    {
+        std::size_t roundedCapacity = 1;
+        while ( roundedCapacity < static_cast<std::size_t>(std::max(capacity, 1)) )
+        {
+            roundedCapacity <<= 1;
+        }
+        m_mask = roundedCapacity - 1;
+        m_slots = std::vector<Slot>(roundedCapacity);
+        for ( std::size_t i = 0; i < roundedCapacity; ++i )
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    SpscQueue(const SpscQueue<T>&) = delete;
+
+    SpscQueue<T>& operator=(const SpscQueue<T>&) = delete;
+
+    ~SpscQueue() = default;
+
+    /*! @brief Enqueues the item. Must be called from one thread only.
+
+        @return false if the item was rejected (REJECT_NEWEST) or an old one was dropped (OVERWRITE_OLDEST)
+    */
+    bool push(T&& t)
+    {
+        bool overwritten = false;
+        const std::size_t pos = m_tail.value.load(std::memory_order_relaxed);
+        Slot& slot = m_slots[pos & m_mask];
+        if ( slot.sequence.load(std::memory_order_acquire) != pos )
+        {
+            if ( m_policy == Policy::REJECT_NEWEST )
+            {
+                ++m_dropped;
+                return false;
+            }
+
+            /* The ring is full, so the slot holds the oldest item. Take exactly that one away from the consumer.
+               If the consumer is just taking it itself, its slot is about to be released, so only wait for that */
+            std::size_t oldest = pos - (m_mask + 1);
+            if ( m_head.value.compare_exchange_strong(oldest, oldest + 1, std::memory_order_relaxed) )
+            {
+                slot.data = T();
+                slot.sequence.store(pos, std::memory_order_release);
+                ++m_dropped;
+                overwritten = true;
+            }
+            while ( slot.sequence.load(std::memory_order_acquire) != pos )
+            {
+                std::this_thread::yield();
+            }
+        }
+
+        slot.data = std::move(t);
+        slot.sequence.store(pos + 1, std::memory_order_release);
+        m_tail.value.store(pos + 1, std::memory_order_release);
+
+        /* Pairs with the fence in wait(): either the consumer sees the item or we see it sleeping */
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if ( m_sleeping.load(std::memory_order_relaxed) )
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_condition.notify_one();
+        }
+        return !overwritten;
+    }
+
+    /*! @brief Enqueues the item waiting for room if the ring is full. Must be called from one thread only.
+
+        With OVERWRITE_OLDEST it is the same as push(). The consumer wakes the producer up when it takes an item.
+
+        @return false if there was no room in time or the queue has been finished, the item is then left intact
+    */
+    bool push(T&& t, std::int64_t waitForMs)
+    {
+        if ( m_policy == Policy::OVERWRITE_OLDEST )
+        {
+            return push(std::move(t));
+        }
+
+        using namespace std::chrono_literals;
+        const auto deadline = std::chrono::steady_clock::now() + waitForMs * 1ms;
+        while ( !hasRoom() )
+        {
+            if ( m_finish || std::chrono::steady_clock::now() >= deadline )
+            {
+                return false;
+            }
+
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_producerSleeping.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            m_space.wait_until(lock, deadline, [this]{ return hasRoom() || m_finish; });
+            m_producerSleeping.store(false, std::memory_order_relaxed);
+        }
+        return push(std::move(t));
+    }
+
+    /*! @brief Dequeues the oldest item if there is one. Never blocks.
+    */
+    bool tryPop(T& t)
+    {
+        std::size_t pos = m_head.value.load(std::memory_order_relaxed);
+        while ( true )
+        {
+            Slot& slot = m_slots[pos & m_mask];
+            const std::size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(sequence) - static_cast<std::ptrdiff_t>(pos + 1);
+            if ( diff < 0 )
+            {
+                return false;
+            }
+            if ( diff > 0 )
+            {
+                pos = m_head.value.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            /* Producer competes for the head only in OVERWRITE_OLDEST mode */
+            if ( m_head.value.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed) )
+            {
+                t = std::move(slot.data);
+                slot.data = T();
+                slot.sequence.store(pos + m_mask + 1, std::memory_order_release);
+
+                /* Pairs with the fence in push(t, waitForMs): either the producer sees the room or we see it sleeping */
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if ( m_producerSleeping.load(std::memory_order_relaxed) )
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    m_space.notify_one();
+                }
+                return true;
+            }
+        }
+    }
+
+    /*! @brief Dequeues the oldest item waiting for it if the ring is empty.
+
+        @return false if nothing arrived in time
+    */
+    bool pop1(T& t, std::int64_t waitForMs)
+    {
+        if ( tryPop(t) )
+        {
+            return true;
+        }
+
+        using namespace std::chrono_literals;
+        const auto deadline = std::chrono::steady_clock::now() + waitForMs * 1ms;
+        while ( true )
+        {
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_sleeping.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_condition.wait_until(lock, deadline, [this]{ return !empty() || m_finish; });
+                m_sleeping.store(false, std::memory_order_relaxed);
+            }
+
+            if ( tryPop(t) )
+            {
+                return true;
+            }
+            if ( m_finish || std::chrono::steady_clock::now() >= deadline )
+            {
+                return false;
+            }
+        }
+    }
+
+    /*! @brief Wakes up a waiting consumer for good (e.g. on shutdown).
+    */
+    void finish()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_finish = true;
+        m_condition.notify_all();
+        m_space.notify_all();
+    }
+
+    bool finished() const noexcept
+    {
+        return m_finish.load();
+    }
+
+    int size() const
+    {
+        const std::size_t tail = m_tail.value.load(std::memory_order_acquire);
+        const std::size_t head = m_head.value.load(std::memory_order_acquire);
+        return ( tail > head ) ? static_cast<int>(tail - head) : 0;
+    }
+
+    bool empty() const
+    {
+        return size() == 0;
+    }
+
+    /*! @brief Drops all items. Must be called from the consumer thread (or when both sides are idle).
+    */
+    void clear()
+    {
+        T t;
+        while ( tryPop(t) );
+    }
+
+    int capacity() const noexcept
+    {
+        return static_cast<int>(m_mask + 1);
+    }
+
+    int policy() const noexcept
+    {
+        return m_policy;
+    }
+
+    /*! @brief Returns the number of items rejected or overwritten because the ring was full.
+    */
+    std::int64_t dropped() const noexcept
+    {
+        return m_dropped.load(std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t CacheLineSize = 64;
+
+    /* Producer side only: the slot at the tail is free */
+    bool hasRoom() const
+    {
+        const std::size_t pos = m_tail.value.load(std::memory_order_relaxed);
+        return m_slots[pos & m_mask].sequence.load(std::memory_order_acquire) == pos;
+    }
+
+    struct alignas(CacheLineSize) Slot
+    {
+        std::atomic<std::size_t> sequence { 0 };
+        T data;
+
+        Slot() = default;
+
+        Slot(Slot&& other) noexcept : sequence(other.sequence.load()), data(std::move(other.data)) {}
+    };
+
+    struct alignas(CacheLineSize) Position
+    {
+        std::atomic<std::size_t> value { 0 };
+    };
+
+    const int m_policy { Policy::REJECT_NEWEST };
+    std::size_t m_mask { 0 };
+    std::vector<Slot> m_slots;
+    Position m_head; //!< consumer position
+    Position m_tail; //!< producer position
+    alignas(CacheLineSize) std::atomic<std::int64_t> m_dropped { 0 };
+
+    /* Only used to sleep while the ring is empty (consumer) or full (producer) */
+    std::atomic<bool> m_sleeping { false };
+    std::atomic<bool> m_producerSleeping { false };
+    std::atomic<bool> m_finish { false };
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::condition_variable m_space;
+};
+
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <functional>
+
+#include <nlohmann/json.hpp>
+using json = nlohmann::json;
+
+
+namespace cvt
+{
+
+/*! @brief Pins the calling thread to the given logical cores. Does nothing if the set is empty.
+
+    @return false if the platform refused (or does not support) the affinity
+*/
+bool pinCurrentThread(const std::vector<int>& cores);
+
+/*! @brief Runs the function to completion on a temporary thread pinned to the cores.
+
+    Threads are born with the affinity of their creator, so a thread pool spawned inside the function
+    (e.g. by an inference session) stays on the cores. Runs the function in place if the set is empty.
+    Exceptions must not escape the function.
+*/
+void runPinned(const std::vector<int>& cores, const std::function<void()>& func);
+
+
+/*! @brief Splits the machine between the thread pools of the toolkit and of the libraries it uses.
+
+    Left alone, OpenCV, ONNX Runtime, LibTorch and detector threads each size themselves to the whole machine.
+    The budget is read from a "thread-budget" JSON node:
+    @code{.json}
+        "thread-budget" :
+        {
+            "opencv" : { "threads" : 2, "cores" : [0, 1] },
+            "inference" : { "threads" : 4, "inter-op-threads" : 1, "cores" : [2, 3, 4, 5] },
+            "detectors" : { "threads" : 2, "cores" : [6, 7] }
+        }
+    @endcode
+    A pool with cores and no thread count gets one thread per core; a pool with neither is left as it is.
+    Apply the budget with setThreadBudget() at startup, before the first frame is processed:
+    @code{.cpp}
+        cvt::setThreadBudget(settings.threadBudget());
+    @endcode
+*/
+struct ThreadBudget
+{
+    struct Pool
+    {
+        int threads { 0 }; //!< 0 - library default
+        std::vector<int> cores; //!< empty - not pinned
+    };
+
+    Pool opencv; //!< cv::parallel_for_ pool and the decoding/encoding threads of the toolkit
+    Pool inference; //!< intra-op pools of ONNX Runtime and LibTorch
+    int inferenceInterOpThreads { 1 };
+    Pool detectors; //!< DetectorScheduler workers and dedicated detector threads
+
+    static ThreadBudget fromJson(json j);
+
+    bool empty() const noexcept;
+
+    /*! @brief Describes the effective layout and warns about oversubscription or overlapping core sets.
+    */
+    std::string summary() const;
+};
+
+
+/*! @brief Makes the budget current and applies the global part of it.
+
+    Sets the OpenCV and LibTorch thread counts and pins the OpenCV workers to the OpenCV cores (a warm-up
+    parallel loop makes the pool start them). The affinity of the calling thread is left alone. Inference sessions
+    and toolkit threads created afterwards read their share from threadBudget().
+*/
+void setThreadBudget(const ThreadBudget& budget);
+
+/*! @brief Returns the cores a thread of the pool should run on.
+
+    That is the pool cores, or every core the process could use when the budget was set if the pool has none.
+    Empty if no budget is set, meaning the affinity is left alone.
+*/
+std::vector<int> budgetCores(const std::vector<int>& poolCores);
+
+/*! @brief Pins the calling thread to budgetCores(poolCores).
+
+    Every thread the toolkit starts calls it first, so that it neither inherits the affinity of its creator nor
+    passes it on. Threads outside of the pools (e.g. the ones running user callbacks) pass no cores.
+*/
+void pinToBudget(const std::vector<int>& poolCores = {});
+
+/*! @brief Returns the current budget (empty unless setThreadBudget() has been called).
+*/
+const ThreadBudget& threadBudget() noexcept;
+
+}
@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
@@ -92,6 +93,19 @@ public:
         return m_state;
     }
 
+    int counter() const noexcept
+    {
+        return m_counter;
+    }
+
+    /*! @brief Restores the counter and the state obtained earlier (e.g. before a restart).
+    */
+    void restore(int counter, bool state) noexcept
+    {
+        m_counter = std::max(0, std::min(counter, m_countBeforeOn + m_countBeforeOff));
+        m_state = state;
+    }
+
     int operator()(bool i)
     {
         return update(i);
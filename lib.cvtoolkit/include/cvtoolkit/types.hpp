@@ -2,6 +2,7 @@
 
 #include <iostream>
 #include <map>
+#include <string_view>
 #include <opencv2/core.hpp>
 
 namespace cvt
@@ -28,7 +29,9 @@ struct InferOut
 {
     int classId;
 
-    std::string className;
+    /** Class name, interned (see internClassName()), so it never dangles and is never copied.
+     */
+    std::string_view className;
 
     float confidence;
 
@@ -58,6 +58,16 @@ json makeJsonObject(const std::string& jPath);
 
 std::pair<bool, std::string> verifyFile(const fs::path& path);
 
+/*! @brief Returns monotonic clock time in ms. Unlike stream timestamps it is comparable between inputs and threads.
+ */
+std::int64_t steadyClockMs() noexcept;
+
+/*! @brief Returns a view of the name which stays valid until the program exits.
+
+    Every distinct name is stored once, so repeated calls do not allocate.
+ */
+std::string_view internClassName( std::string_view name );
+
 template <typename T>
 static T clip(const T& n, const T& lower, const T& upper)
 {
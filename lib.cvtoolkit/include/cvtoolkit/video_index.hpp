@@ -0,0 +1,77 @@
+#pragma once
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+namespace cvt
+{
+
+/*! @brief The class holds keyframe positions and presentation timestamps of a recorded video.
+
+    The index is built by demuxing the file without decoding (FFmpeg raw mode) and is cached next to the video
+    in a sidecar file, so reopening a multi-hour recording costs one small read.
+    Seeking to an arbitrary frame then costs one jump to the preceding keyframe plus decoding the rest of its GOP.
+
+    @note Keyframe positions are frame numbers in presentation order. Without valid PTS they fall back
+    to packet numbers in decode order, which equal frame numbers only if there are no B-frames.
+*/
+class VideoIndex final
+{
+public:
+    VideoIndex() = default;
+
+    ~VideoIndex() = default;
+
+    /*! @brief Loads the sidecar index or builds (and saves) it if the sidecar is missing or outdated.
+
+        @param videoPath path to the video file
+        @param useSidecar whether to read/write the sidecar file
+        @param cancel (optional) flag to abort building, e.g. on shutdown
+
+        @return Whether the index is available
+    */
+    bool open(const std::string& videoPath, bool useSidecar = true, const std::atomic<bool>* cancel = nullptr);
+
+    /*! @brief Builds the index by demuxing the whole video.
+    */
+    bool build(const std::string& videoPath, const std::atomic<bool>* cancel = nullptr);
+
+    bool load(const std::string& indexPath, const std::string& videoPath);
+
+    bool save(const std::string& indexPath, const std::string& videoPath) const;
+
+    bool empty() const noexcept;
+
+    int frames() const noexcept;
+
+    /*! @brief Returns the closest keyframe at or before the given frame.
+    */
+    int keyframeBefore(int frameNum) const;
+
+    bool isKeyframe(int frameNum) const;
+
+    /*! @brief Returns frame presentation time in ms counted from the first frame or -1 if unknown.
+    */
+    std::int64_t timestamp(int frameNum) const;
+
+    /*! @brief Returns the last frame presented at or before the given time.
+    */
+    int frameAt(std::int64_t timestampMs) const;
+
+    static std::string sidecarPath(const std::string& videoPath);
+
+    /*! @brief Says whether the OpenCV build is able to demux without decoding.
+    */
+    static bool supported() noexcept;
+
+private:
+    std::vector<std::int64_t> m_timestamps;
+    std::vector<int> m_keyframes;
+};
+
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+
+#include <opencv2/core.hpp>
+#include <opencv2/videoio.hpp>
+
+#include "frame_pool.hpp"
+#include "concurrent_queue.hpp"
+
+namespace cvt
+{
+
+/*! @brief The class encodes video on a background thread.
+
+    write() only copies the frame into a pooled buffer and enqueues it, so the processing thread does not pay for encoding.
+    When the queue is full the frame is either dropped or the caller waits, depending on the policy. Its usage looks like
+    @code{.cpp}
+        cvt::AsyncVideoWriter::Params params;
+        params.path = "detections.mp4";
+        params.fourcc = "mp4v";
+        params.fps = player->fps();
+        cvt::AsyncVideoWriter writer(params);
+        writer.write(frame);
+    @endcode
+*/
+class AsyncVideoWriter final
+{
+public:
+    enum Policy
+    {
+        DROP, //!< drop the frame if the queue is full
+        BLOCK //!< wait until the encoder frees a place in the queue
+    };
+
+    struct Params
+    {
+        std::string path { "output.avi" };
+        std::string fourcc { "MJPG" };
+        double fps { 0.0 }; //!< 0 - the rate of the input (25 if unknown)
+        int queueSize { 16 };
+        int policy { Policy::BLOCK };
+    };
+
+    explicit AsyncVideoWriter(const Params& params);
+
+    AsyncVideoWriter(const AsyncVideoWriter&) = delete;
+
+    AsyncVideoWriter& operator=(const AsyncVideoWriter&) = delete;
+
+    /*! @brief Encodes the frames left in the queue and closes the file.
+    */
+    ~AsyncVideoWriter();
+
+    /*! @brief Enqueues a copy of the frame. The file is opened on the first frame.
+
+        @return false if the frame was dropped
+    */
+    bool write(const cv::Mat& frame);
+
+    /*! @brief Encodes the frames left in the queue and closes the file.
+    */
+    void release();
+
+    const Params& params() const noexcept;
+
+    bool isOpened() const noexcept;
+
+    int queueDepth() const;
+
+    int maxQueueDepth() const noexcept;
+
+    std::int64_t written() const noexcept;
+
+    std::int64_t dropped() const noexcept;
+
+    /*! @brief Returns average encoding time of a frame in ms.
+    */
+    double encodeLatency() const noexcept;
+
+    double maxEncodeLatency() const noexcept;
+
+    std::string summary() const;
+
+private:
+    const Params m_params;
+    cv::VideoWriter m_writer;
+    std::shared_ptr<FramePool> m_pool;
+    ConcurrentQueue<FrameHandle> m_queue;
+    std::thread m_thread;
+    std::atomic<bool> m_stop { false };
+    std::atomic<bool> m_opened { false };
+
+    std::atomic<int> m_maxQueueDepth { 0 };
+    std::atomic<std::int64_t> m_written { 0 };
+    std::atomic<std::int64_t> m_dropped { 0 };
+    std::atomic<std::int64_t> m_encodeTimeUs { 0 };
+    std::atomic<std::int64_t> m_maxEncodeTimeUs { 0 };
+
+    bool open(const cv::Mat& frame);
+
+    void encodeLoop();
+};
+
+}
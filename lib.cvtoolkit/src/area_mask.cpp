@@ -0,0 +1,93 @@
+#include "cvtoolkit/area_mask.hpp"
+
+#include <opencv2/imgproc.hpp>
+
+
+namespace cvt
+{
+
+AreaMask::AreaMask(const Areas& areas, cv::Size size)
+    : m_size(size)
+{
+    m_mask = cv::Mat::zeros(size, CV_8U);
+    cv::drawContours(m_mask, areas, -1, cv::Scalar::all(255), -1);
+
+    /* Run-length encode the rows */
+    m_rowStarts.reserve(size.height + 1);
+    int xMin = size.width, xMax = -1, yMin = size.height, yMax = -1;
+    for ( int y = 0; y < size.height; ++y )
+    {
+        m_rowStarts.emplace_back(static_cast<int>(m_spans.size()));
+        const uchar* row = m_mask.ptr<uchar>(y);
+        int x = 0;
+        while ( x < size.width )
+        {
+            while ( x < size.width && row[x] == 0 ) ++x;
+            if ( x == size.width )
+            {
+                break;
+            }
+            const int start = x;
+            while ( x < size.width && row[x] != 0 ) ++x;
+            m_spans.emplace_back(Span{ start, x });
+            m_area += x - start;
+            xMin = std::min(xMin, start);
+            xMax = std::max(xMax, x);
+            yMin = std::min(yMin, y);
+            yMax = std::max(yMax, y + 1);
+        }
+    }
+    m_rowStarts.emplace_back(static_cast<int>(m_spans.size()));
+
+    if ( m_area > 0 )
+    {
+        m_boundingRect = cv::Rect(xMin, yMin, xMax - xMin, yMax - yMin);
+    }
+}
+
+bool AreaMask::empty() const noexcept
+{
+    return m_area == 0;
+}
+
+cv::Size AreaMask::size() const noexcept
+{
+    return m_size;
+}
+
+const cv::Mat& AreaMask::mask() const noexcept
+{
+    return m_mask;
+}
+
+const cv::Rect& AreaMask::boundingRect() const noexcept
+{
+    return m_boundingRect;
+}
+
+int AreaMask::area() const noexcept
+{
+    return m_area;
+}
+
+const std::vector<Span>& AreaMask::spans() const noexcept
+{
+    return m_spans;
+}
+
+std::pair<const Span*, const Span*> AreaMask::rowSpans(int y) const noexcept
+{
+    if ( y < 0 || y >= m_size.height )
+    {
+        return { nullptr, nullptr };
+    }
+    const Span* first = m_spans.data();
+    return { first + m_rowStarts[y], first + m_rowStarts[y + 1] };
+}
+
+bool AreaMask::contains(cv::Point pt) const noexcept
+{
+    return m_boundingRect.contains(pt) && m_mask.at<uchar>(pt.y, pt.x) != 0;
+}
+
+}
@@ -0,0 +1,265 @@
+#include "cvtoolkit/async_detector.hpp"
+#include "cvtoolkit/detector_scheduler.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <chrono>
+
+namespace cvt
+{
+
+namespace
+{
+
+const double StageTimeAlpha = 0.1;
+
+const std::int64_t PopTimeoutMs = 100;
+
+const char* const StageNames[] = { "preprocess", "infer", "postprocess" };
+
+}
+
+AsyncDetectorRunner::AsyncDetectorRunner(const std::shared_ptr<Detector>& detector, int depth, Completion completion,
+                                         Release release, const std::string& name)
+    : m_detector(detector)
+    , m_name(name)
+    , m_depth(std::max(1, depth))
+    , m_completion(std::move(completion))
+    , m_release(std::move(release))
+{
+    for ( int stage = 0; stage < STAGES; ++stage )
+    {
+        m_queues[stage] = std::make_unique<SpscQueue<TaskPtr>>(m_depth, SpscQueue<TaskPtr>::REJECT_NEWEST);
+        m_stageMs[stage] = 0.0;
+    }
+    m_freeTasks.reserve(m_depth);
+    for ( int i = 0; i < m_depth; ++i )
+    {
+        m_freeTasks.emplace_back(std::make_unique<Task>());
+    }
+    for ( int stage = 0; stage < STAGES; ++stage )
+    {
+        m_threads[stage] = std::thread(&AsyncDetectorRunner::stageLoop, this, stage);
+    }
+}
+
+AsyncDetectorRunner::~AsyncDetectorRunner()
+{
+    finish();
+}
+
+std::future<Detector::OutputData> AsyncDetectorRunner::submit(Detector::InputData&& in)
+{
+    std::promise<Detector::OutputData> promise;
+    std::future<Detector::OutputData> result = promise.get_future();
+    TaskPtr task;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]{ return m_inFlight < m_depth || m_stop; });
+        if ( m_stop )
+        {
+            promise.set_value(Detector::OutputData());
+            return result;
+        }
+        ++m_inFlight;
+        task = acquire();
+    }
+
+    /* At most depth tasks exist, so the ring never rejects one */
+    task->promise = std::move(promise);
+    task->promised = true;
+    task->job.in = std::move(in);
+    m_queues[PREPROCESS]->push(std::move(task));
+    return result;
+}
+
+bool AsyncDetectorRunner::trySubmit(Detector::InputData& in)
+{
+    TaskPtr task;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ( m_inFlight >= m_depth || m_stop )
+        {
+            return false;
+        }
+        ++m_inFlight;
+        task = acquire();
+    }
+
+    task->job.in = std::move(in);
+    m_queues[PREPROCESS]->push(std::move(task));
+    return true;
+}
+
+void AsyncDetectorRunner::finish()
+{
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_condition.wait(lock, [this]{ return m_inFlight == 0; });
+        m_stop = true;
+    }
+    m_condition.notify_all();
+
+    for ( int stage = 0; stage < STAGES; ++stage )
+    {
+        m_queues[stage]->finish();
+    }
+    for ( auto& thread : m_threads )
+    {
+        if ( thread.joinable() )
+        {
+            thread.join();
+        }
+    }
+}
+
+int AsyncDetectorRunner::depth() const noexcept
+{
+    return m_depth;
+}
+
+int AsyncDetectorRunner::inFlight() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inFlight;
+}
+
+double AsyncDetectorRunner::cpuTime() const noexcept
+{
+    return m_cpuTimeUs / 1000.0;
+}
+
+double AsyncDetectorRunner::stageTime(int stage) const noexcept
+{
+    return ( stage >= 0 && stage < STAGES ) ? m_stageMs[stage].load() : 0.0;
+}
+
+std::string AsyncDetectorRunner::summary() const
+{
+    std::ostringstream oss;
+    oss << "[AsyncDetectorRunner] depth " << m_depth 
+        << ", preprocess " << stageTime(PREPROCESS) << " ms"
+        << ", infer " << stageTime(INFER) << " ms"
+        << ", postprocess " << stageTime(POSTPROCESS) << " ms"
+        << ", CPU time " << cpuTime() << " ms"
+        << ", failed frames " << failedFrames();
+    return oss.str();
+}
+
+std::int64_t AsyncDetectorRunner::failedFrames() const noexcept
+{
+    return m_failedFrames;
+}
+
+AsyncDetectorRunner::TaskPtr AsyncDetectorRunner::acquire()
+{
+    /* A task goes back to the list before m_inFlight drops, so the list is never empty here */
+    TaskPtr task = std::move(m_freeTasks.back());
+    m_freeTasks.pop_back();
+    return task;
+}
+
+void AsyncDetectorRunner::fail(Task& task, int stage, const char* what)
+{
+    std::cerr << ">>> [AsyncDetectorRunner] " << StageNames[stage] << " of " << m_name << " failed: " << what << std::endl;
+    task.failed = true;
+    if ( task.promised )
+    {
+        task.promise.set_exception(std::current_exception());
+    }
+}
+
+void AsyncDetectorRunner::stageLoop(int stage)
+{
+    const ThreadBudget& budget = threadBudget();
+    pinToBudget(( stage == INFER ) ? budget.inference.cores : budget.detectors.cores);
+    while ( true )
+    {
+        TaskPtr task;
+        if ( !m_queues[stage]->pop1(task, PopTimeoutMs) )
+        {
+            /* finish() stops only when nothing is in flight */
+            if ( m_stop )
+            {
+                break;
+            }
+            continue;
+        }
+
+        if ( !task->failed && !task->job.skip )
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const std::int64_t cpuStart = threadCpuTimeUs();
+            try
+            {
+                switch ( stage )
+                {
+                case PREPROCESS:
+                    m_detector->preprocess(task->job);
+                    break;
+                case INFER:
+                    m_detector->infer(task->job);
+                    break;
+                default:
+                    m_detector->postprocess(task->job);
+                    break;
+                }
+            }
+            catch ( const std::exception& e )
+            {
+                fail(*task, stage, e.what());
+            }
+            catch ( ... )
+            {
+                fail(*task, stage, "unknown exception");
+            }
+            m_cpuTimeUs += threadCpuTimeUs() - cpuStart;
+
+            const double elapsedMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            const double prevMs = m_stageMs[stage];
+            m_stageMs[stage] = ( prevMs > 0.0 ) ? (1.0 - StageTimeAlpha) * prevMs + StageTimeAlpha * elapsedMs : elapsedMs;
+        }
+
+        if ( stage + 1 < STAGES )
+        {
+            m_queues[stage + 1]->push(std::move(task));
+            continue;
+        }
+
+        if ( task->failed )
+        {
+            ++m_failedFrames;
+        }
+        else
+        {
+            if ( m_completion )
+            {
+                m_completion(task->job);
+            }
+            if ( task->promised )
+            {
+                task->promise.set_value(std::move(task->job.out));
+            }
+        }
+
+        /* The frame is released before a new one is let in, the other buffers are kept for the next frame */
+        task->job.in = Detector::InputData();
+        task->job.out.reset();
+        task->job.skip = false;
+        task->job.rois.clear();
+        task->promised = false;
+        task->failed = false;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_freeTasks.emplace_back(std::move(task));
+            --m_inFlight;
+        }
+        m_condition.notify_all();
+        if ( m_release )
+        {
+            m_release();
+        }
+    }
+}
+
+}
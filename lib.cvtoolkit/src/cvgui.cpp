@@ -33,7 +33,11 @@ int GUI::listenKeyboard()
         m_player->backToStart();
         break;
     case 32 /* space */:
-        if ( !m_pause )
+        if ( !m_pause && m_player->seekable() )
+        {
+            m_player->seek(m_player->frameNum() + static_cast<int>(m_player->fps()));
+        }
+        else if ( !m_pause )
         {
             cv::Mat frame;
             for (int i = 0; i < m_player->fps(); ++i) 
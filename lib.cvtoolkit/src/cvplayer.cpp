@@ -1,4 +1,8 @@
 #include <cvtoolkit/cvplayer.hpp>
+#include <cvtoolkit/utils.hpp>
+#include <cvtoolkit/thread_budget.hpp>
+
+#include <chrono>
 
 namespace cvt
 {
@@ -27,6 +31,16 @@ OpenCVPlayer::OpenCVPlayer(const std::string& input, double scaleFactor)
         }
         return;
     }
+    else if ( m_inputType == InputType::RECORDING )
+    {
+        openRecording();
+        return;
+    }
+    else if ( m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        openSequence();
+        return;
+    }
 
     if( !m_capture.isOpened() )
     {
@@ -45,6 +59,7 @@ OpenCVPlayer::OpenCVPlayer(const std::string& input, double scaleFactor)
         cv::resize(m_frame0, m_frame0, cv::Size(0, 0), scaleFactor, scaleFactor);
     }
 
+    openIndex();
     backToStart();
 
     m_fps = m_capture.get(cv::CAP_PROP_FPS);
@@ -74,6 +89,16 @@ OpenCVPlayer::OpenCVPlayer(const std::string& input, cv::Size inputSize)
         }
         return;
     }
+    else if ( m_inputType == InputType::RECORDING )
+    {
+        openRecording();
+        return;
+    }
+    else if ( m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        openSequence();
+        return;
+    }
 
     if( !m_capture.isOpened() )
     {
@@ -94,6 +119,7 @@ OpenCVPlayer::OpenCVPlayer(const std::string& input, cv::Size inputSize)
         cv::resize(m_frame0, m_frame0, m_inputSize);
     }
 
+    openIndex();
     backToStart();
 
     m_fps = m_capture.get(cv::CAP_PROP_FPS);
@@ -102,9 +128,16 @@ OpenCVPlayer::OpenCVPlayer(const std::string& input, cv::Size inputSize)
 
 OpenCVPlayer::~OpenCVPlayer()
 {
-    if ( m_writer.isOpened() )
+    m_indexBuild.cancel = true;
+    if ( m_indexBuild.thread.joinable() )
+    {
+        m_indexBuild.thread.join();
+    }
+    disablePrefetch();
+    disableLiveMode();
+    if ( m_writer )
     {
-        m_writer.release();
+        m_writer->release();
     }
     m_capture.release();
 }
@@ -116,14 +149,148 @@ void OpenCVPlayer::read(cv::Mat& out)
         out = m_frame0.clone();
         return;
     }
+    adoptIndex();
+
+    if ( m_live.enabled )
+    {
+        /* Only the newest grabbed frame is ever decoded */
+        std::unique_lock<std::mutex> captureLock(m_captureMutex, std::defer_lock);
+        if ( !takeLiveFrame(captureLock) )
+        {
+            ++m_frameNum;
+            out.release();
+            return;
+        }
+        retrieve(out);
+        return;
+    }
+
+    if ( m_prefetch.enabled )
+    {
+        std::unique_lock<std::mutex> lock(m_prefetch.mutex);
+        if ( m_prefetch.count == 0 && !m_prefetch.eof )
+        {
+            ++m_prefetch.underruns;
+            m_prefetch.notEmpty.wait(lock, [this]{ return m_prefetch.count > 0 || m_prefetch.eof; });
+        }
+        ++m_frameNum;
+        if ( m_prefetch.count == 0 )
+        {
+            out.release();
+            return;
+        }
+
+        /* Hand the ready slot over and take the caller's buffer in exchange */
+        cv::swap(out, m_prefetch.slots[m_prefetch.head]);
+        m_prefetch.head = (m_prefetch.head + 1) % static_cast<int>(m_prefetch.slots.size());
+        --m_prefetch.count;
+        m_prefetch.notFull.notify_one();
+        return;
+    }
 
-    m_capture >> out;
+    decode(out);
     ++m_frameNum;
-    
-    if ( (!m_inputSize.empty() || 1.0 != m_scaleFactor) && m_doResize && !out.empty() )
+}
+
+bool OpenCVPlayer::grab()
+{
+    if ( m_inputType == InputType::IMAGE )
+    {
+        return !m_frame0.empty();
+    }
+    adoptIndex();
+
+    if ( m_live.enabled )
+    {
+        /* The grabbed frame is skipped without decoding */
+        std::unique_lock<std::mutex> captureLock(m_captureMutex, std::defer_lock);
+        return takeLiveFrame(captureLock);
+    }
+
+    if ( m_prefetch.enabled )
+    {
+        /* The frame is already decoded, just hand the slot back */
+        read(m_skipBuffer);
+        return !m_skipBuffer.empty();
+    }
+
+    if ( m_inputType == InputType::RECORDING )
+    {
+        ++m_frameNum;
+        return ++m_storePos <= m_store.frames();
+    }
+    if ( m_inputType == InputType::IMAGE_SEQUENCE )
     {
-        cv::resize(out, out, m_inputSize, m_scaleFactor, m_scaleFactor);
+        const bool retval = m_sequence->read(m_skipBuffer);
+        m_frameNum = m_sequence->position(); // skipped files keep their numbers
+        return retval;
     }
+
+    const bool retval = m_capture.grab();
+    ++m_frameNum;
+    return retval;
+}
+
+void OpenCVPlayer::decode(cv::Mat& out)
+{
+    if ( m_inputType == InputType::RECORDING )
+    {
+        /* No decoding, just a copy out of the page cache */
+        const cv::Mat stored = m_store.frame(m_storePos++);
+        if ( stored.empty() )
+        {
+            out.release();
+        }
+        else if ( m_doResize )
+        {
+            cv::resize(stored, out, m_inputSize, m_scaleFactor, m_scaleFactor);
+        }
+        else
+        {
+            stored.copyTo(out);
+        }
+        return;
+    }
+
+    if ( m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        /* Already decoded (and resized) by the sequence workers. The caller counts the frame,
+           skipped files are counted here so that numbers and timestamps stay those of the files */
+        m_sequence->read(out);
+        m_frameNum = m_sequence->position() - 1;
+        return;
+    }
+
+    if ( !m_doResize )
+    {
+        m_capture >> out;
+        return;
+    }
+
+    m_capture >> m_decodeBuffer;
+    if ( m_decodeBuffer.empty() )
+    {
+        out.release();
+        return;
+    }
+    cv::resize(m_decodeBuffer, out, m_inputSize, m_scaleFactor, m_scaleFactor);
+}
+
+void OpenCVPlayer::retrieve(cv::Mat& out)
+{
+    if ( !m_doResize )
+    {
+        m_capture.retrieve(out);
+        return;
+    }
+
+    m_capture.retrieve(m_decodeBuffer);
+    if ( m_decodeBuffer.empty() )
+    {
+        out.release();
+        return;
+    }
+    cv::resize(m_decodeBuffer, out, m_inputSize, m_scaleFactor, m_scaleFactor);
 }
 
 OpenCVPlayer& OpenCVPlayer::operator >> (cv::Mat& out)
@@ -132,6 +299,21 @@ OpenCVPlayer& OpenCVPlayer::operator >> (cv::Mat& out)
     return *this;
 }
 
+OpenCVPlayer& OpenCVPlayer::operator >> (const FrameHandle& out)
+{
+    if ( !out )
+    {
+        return *this;
+    }
+
+    read(out->image);
+    out->frameNum = m_frameNum;
+    out->keyframe = isKeyframe();
+    out->timestamp = timestamp();
+    out->captureTime = steadyClockMs();
+    return *this;
+}
+
 void OpenCVPlayer::write(const cv::Mat& frame)
 {
     if ( m_inputType == InputType::IMAGE )
@@ -151,12 +333,23 @@ void OpenCVPlayer::write(const cv::Mat& frame)
         return;
     }
 
-    if ( !m_writer.isOpened() )
+    if ( !m_writer )
     {
-        m_writer.open("output.avi", cv::VideoWriter::fourcc('M','J','P','G'), 
-                    m_fps, frame.size(), true);
+        AsyncVideoWriter::Params params = m_writerParams;
+        params.fps = ( params.fps > 0.0 ) ? params.fps : m_fps;
+        m_writer = std::make_unique<AsyncVideoWriter>(params);
     }
-    m_writer.write(frame);
+    m_writer->write(frame);
+}
+
+void OpenCVPlayer::setWriterParams(const AsyncVideoWriter::Params& params)
+{
+    m_writerParams = params;
+}
+
+const AsyncVideoWriter* OpenCVPlayer::writer() const noexcept
+{
+    return m_writer.get();
 }
 
 OpenCVPlayer& OpenCVPlayer::operator << (const cv::Mat& frame)
@@ -167,12 +360,30 @@ OpenCVPlayer& OpenCVPlayer::operator << (const cv::Mat& frame)
 
 double OpenCVPlayer::get(int propId) const
 {
+    std::lock_guard<std::mutex> lock(m_captureMutex);
     return m_capture.get(propId);
 }
 
 bool OpenCVPlayer::set(int propId, double value)
 {
-    return m_capture.set(propId, value);
+    if ( m_live.enabled )
+    {
+        stopLiveThread();
+        const bool retval = m_capture.set(propId, value);
+        startLiveThread();
+        return retval;
+    }
+
+    if ( !m_prefetch.enabled )
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        return m_capture.set(propId, value);
+    }
+
+    stopPrefetchThread();
+    const bool retval = m_capture.set(propId, value);
+    startPrefetchThread();
+    return retval;
 }
 
 const cv::Mat& OpenCVPlayer::frame0() const noexcept
@@ -185,6 +396,20 @@ const double OpenCVPlayer::fps() const noexcept
     return m_fps;
 }
 
+void OpenCVPlayer::setFrameRate(double fps)
+{
+    if ( fps <= 0 )
+    {
+        return;
+    }
+
+    m_fps = fps;
+    if ( m_sequence )
+    {
+        m_sequence->setFrameRate(fps);
+    }
+}
+
 int OpenCVPlayer::frameNum() const noexcept
 {
     return m_frameNum;
@@ -192,6 +417,29 @@ int OpenCVPlayer::frameNum() const noexcept
 
 std::int64_t OpenCVPlayer::timestamp() const noexcept
 {
+    if ( m_live.enabled )
+    {
+        return m_liveTimestamp;
+    }
+
+    /* Real presentation time is preferred, it differs from the nominal one for variable frame rate */
+    std::int64_t pts = -1;
+    if ( m_inputType == InputType::RECORDING )
+    {
+        pts = m_store.timestamp(m_frameNum - 1);
+    }
+    else if ( m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        pts = m_sequence->timestamp(m_frameNum - 1);
+    }
+    else
+    {
+        pts = m_index.timestamp(m_frameNum - 1);
+    }
+    if ( pts >= 0 )
+    {
+        return pts;
+    }
     return 1000 * (m_frameNum / m_fps);
 }
 
@@ -201,8 +449,16 @@ int OpenCVPlayer::getInputType(const std::string& input) const
     {
         return InputType::WEBCAM;
     }
+    if ( ImageSequenceReader::isSequence(input) )
+    {
+        return InputType::IMAGE_SEQUENCE;
+    }
     
     std::string ext = input.substr(input.length() - 4);
+    if ( ext == frameStoreContainer )
+    {
+        return InputType::RECORDING;
+    }
     if (std::find(supportedImageContainers.begin(), supportedImageContainers.end(), ext) != supportedImageContainers.end())
     {
         return InputType::IMAGE;
@@ -229,8 +485,515 @@ int OpenCVPlayer::getInputType(const std::string& input) const
 
 void OpenCVPlayer::backToStart()
 {
-    m_capture.set(cv::CAP_PROP_POS_MSEC, 0);
-    m_frameNum = 0;
+    if ( m_prefetch.enabled )
+    {
+        stopPrefetchThread();
+    }
+    if ( m_live.enabled )
+    {
+        stopLiveThread();
+    }
+
+    if ( seekable() )
+    {
+        seekCapture(0);
+    }
+    else
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        m_capture.set(cv::CAP_PROP_POS_MSEC, 0);
+        m_frameNum = 0;
+    }
+
+    if ( m_prefetch.enabled )
+    {
+        startPrefetchThread();
+    }
+    if ( m_live.enabled )
+    {
+        startLiveThread();
+    }
 }
 
-}
\ No newline at end of file
+bool OpenCVPlayer::seek(int frameNum)
+{
+    if ( !seekable() )
+    {
+        return false;
+    }
+    adoptIndex();
+
+    if ( m_prefetch.enabled )
+    {
+        stopPrefetchThread();
+    }
+
+    seekCapture(frameNum);
+
+    if ( m_prefetch.enabled )
+    {
+        startPrefetchThread();
+    }
+    return true;
+}
+
+bool OpenCVPlayer::seekTimestamp(std::int64_t timestampMs)
+{
+    adoptIndex();
+    if ( !m_index.empty() )
+    {
+        return seek(m_index.frameAt(timestampMs));
+    }
+    if ( m_inputType != InputType::VIDEO || !seekable() )
+    {
+        return seek(static_cast<int>(timestampMs * m_fps / 1000));
+    }
+
+    /* No index (yet), the backend seeks by time */
+    if ( m_prefetch.enabled )
+    {
+        stopPrefetchThread();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_captureMutex);
+        m_capture.set(cv::CAP_PROP_POS_MSEC, static_cast<double>(std::max<std::int64_t>(timestampMs, 0)));
+        m_frameNum = static_cast<int>(m_capture.get(cv::CAP_PROP_POS_FRAMES));
+    }
+    if ( m_prefetch.enabled )
+    {
+        startPrefetchThread();
+    }
+    return true;
+}
+
+bool OpenCVPlayer::seekable() const noexcept
+{
+    return (m_inputType == InputType::VIDEO && m_capture.isOpened()) 
+        || (m_inputType == InputType::RECORDING && m_store.isOpened())
+        || (m_inputType == InputType::IMAGE_SEQUENCE && m_sequence->isOpened());
+}
+
+bool OpenCVPlayer::isKeyframe() const noexcept
+{
+    if ( m_inputType == InputType::IMAGE || m_inputType == InputType::RECORDING 
+        || m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        return true;
+    }
+    return m_index.isKeyframe(m_frameNum - 1);
+}
+
+const VideoIndex& OpenCVPlayer::index() const noexcept
+{
+    return m_index;
+}
+
+void OpenCVPlayer::openIndex()
+{
+    if ( m_inputType != InputType::VIDEO || !VideoIndex::supported() )
+    {
+        return;
+    }
+
+    if ( m_index.load(VideoIndex::sidecarPath(m_input), m_input) )
+    {
+        return;
+    }
+
+    /* Demuxing a multi-hour recording takes a while, so the index is built (and saved) in background.
+       Until it is adopted, seeking goes through the backend */
+    m_indexBuild.thread = std::thread([this]
+    {
+        pinToBudget(threadBudget().opencv.cores);
+        if ( m_indexBuild.built.open(m_input, true, &m_indexBuild.cancel) )
+        {
+            m_indexBuild.ready = true;
+        }
+        else if ( !m_indexBuild.cancel )
+        {
+            std::cout << ">>> [OpenCVPlayer] Keyframe index is not available, seeking falls back to the backend" << std::endl;
+        }
+    });
+}
+
+void OpenCVPlayer::adoptIndex()
+{
+    if ( !m_indexBuild.ready.exchange(false) )
+    {
+        return;
+    }
+
+    m_indexBuild.thread.join();
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+    m_index = std::move(m_indexBuild.built);
+}
+
+void OpenCVPlayer::openRecording()
+{
+    if ( !m_store.open(m_input) || m_store.frames() == 0 )
+    {
+        std::cout << ">>> ERROR: Could not open frame store " << m_input << std::endl;
+        return;
+    }
+
+    const cv::Mat stored = m_store.frame(0);
+    m_doResize = (m_scaleFactor != 1.0) || (!m_inputSize.empty() && stored.size() != m_inputSize);
+    decode(m_frame0);
+    m_storePos = 0;
+
+    m_fps = m_store.fps();
+    m_fps = ( m_fps > 0 ) ? m_fps : 25;
+}
+
+void OpenCVPlayer::openSequence()
+{
+    m_sequence = std::make_unique<ImageSequenceReader>(m_input, m_inputSize, m_scaleFactor);
+    if ( !m_sequence->read(m_frame0) )
+    {
+        std::cout << ">>> ERROR: Could not read images from " << m_input << std::endl;
+        return;
+    }
+    m_sequence->seek(0);
+    m_fps = 25;
+}
+
+void OpenCVPlayer::seekCapture(int frameNum)
+{
+    std::lock_guard<std::mutex> lock(m_captureMutex);
+
+    frameNum = std::max(frameNum, 0);
+    if ( m_inputType == InputType::RECORDING )
+    {
+        m_storePos = std::min(frameNum, m_store.frames());
+        m_frameNum = m_storePos;
+        return;
+    }
+    if ( m_inputType == InputType::IMAGE_SEQUENCE )
+    {
+        m_sequence->seek(frameNum);
+        m_frameNum = std::min(frameNum, m_sequence->frames());
+        return;
+    }
+
+    if ( m_index.empty() )
+    {
+        if ( frameNum > 0 && m_fps > 0.0 )
+        {
+            m_capture.set(cv::CAP_PROP_POS_MSEC, 1000.0 * frameNum / m_fps);
+        }
+        else
+        {
+            m_capture.set(cv::CAP_PROP_POS_FRAMES, frameNum);
+        }
+        m_frameNum = frameNum;
+        return;
+    }
+
+    frameNum = std::min(frameNum, m_index.frames() - 1);
+    const int keyframe = m_index.keyframeBefore(frameNum);
+
+    /* Going forward within the current GOP needs no jump at all */
+    if ( m_frameNum < keyframe || m_frameNum > frameNum )
+    {
+        m_capture.set(cv::CAP_PROP_POS_FRAMES, keyframe);
+        m_frameNum = keyframe;
+    }
+    while ( m_frameNum < frameNum && m_capture.grab() )
+    {
+        ++m_frameNum;
+    }
+}
+
+void OpenCVPlayer::enablePrefetch(int capacity)
+{
+    /* Image sequences are decoded ahead by their own workers */
+    if ( m_inputType == InputType::IMAGE || m_inputType == InputType::IMAGE_SEQUENCE || m_frame0.empty() )
+    {
+        return;
+    }
+    if ( m_inputType != InputType::RECORDING && !m_capture.isOpened() )
+    {
+        return;
+    }
+
+    disablePrefetch();
+    disableLiveMode();
+
+    /* Preallocate slots so that steady-state decoding does not allocate */
+    m_prefetch.slots.resize(std::max(capacity, 1));
+    for ( auto& slot : m_prefetch.slots )
+    {
+        slot.create(m_frame0.size(), m_frame0.type());
+    }
+    m_prefetch.underruns = 0;
+    m_prefetch.enabled = true;
+
+    startPrefetchThread();
+}
+
+void OpenCVPlayer::disablePrefetch()
+{
+    if ( !m_prefetch.enabled )
+    {
+        return;
+    }
+
+    stopPrefetchThread();
+    m_prefetch.slots.clear();
+    m_prefetch.enabled = false;
+}
+
+bool OpenCVPlayer::prefetching() const noexcept
+{
+    return m_prefetch.enabled;
+}
+
+int OpenCVPlayer::prefetchFillLevel() const
+{
+    std::lock_guard<std::mutex> lock(m_prefetch.mutex);
+    return m_prefetch.count;
+}
+
+std::int64_t OpenCVPlayer::prefetchUnderruns() const noexcept
+{
+    return m_prefetch.underruns;
+}
+
+void OpenCVPlayer::startPrefetchThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch.mutex);
+        m_prefetch.head = 0;
+        m_prefetch.count = 0;
+        m_prefetch.stop = false;
+        m_prefetch.eof = false;
+    }
+    m_prefetch.thread = std::thread(&OpenCVPlayer::prefetchLoop, this);
+}
+
+void OpenCVPlayer::stopPrefetchThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch.mutex);
+        m_prefetch.stop = true;
+    }
+    m_prefetch.notFull.notify_all();
+    if ( m_prefetch.thread.joinable() )
+    {
+        m_prefetch.thread.join();
+    }
+
+    /* Frames decoded ahead are dropped, so rewind a recorded video to the last consumed one.
+       The capture is ahead by the frames left in the ring, which is where seekCapture() jumps back from */
+    if ( m_inputType == InputType::VIDEO && (m_prefetch.count > 0 || m_prefetch.eof) )
+    {
+        const int consumed = m_frameNum;
+        m_frameNum += m_prefetch.count;
+        seekCapture(consumed);
+    }
+    else if ( m_inputType == InputType::RECORDING )
+    {
+        m_storePos = m_frameNum;
+    }
+}
+
+void OpenCVPlayer::prefetchLoop()
+{
+    pinToBudget(threadBudget().opencv.cores);
+    const int capacity = static_cast<int>(m_prefetch.slots.size());
+    while ( true )
+    {
+        int tail = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_prefetch.mutex);
+            m_prefetch.notFull.wait(lock, [this, capacity]{ return m_prefetch.count < capacity || m_prefetch.stop; });
+            if ( m_prefetch.stop )
+            {
+                break;
+            }
+            tail = (m_prefetch.head + m_prefetch.count) % capacity;
+        }
+
+        /* The tail slot is not visible to the reader until count is incremented */
+        cv::Mat& slot = m_prefetch.slots[tail];
+        {
+            std::lock_guard<std::mutex> lock(m_captureMutex);
+            decode(slot);
+        }
+
+        std::lock_guard<std::mutex> lock(m_prefetch.mutex);
+        if ( slot.empty() )
+        {
+            m_prefetch.eof = true;
+            m_prefetch.notEmpty.notify_all();
+            break;
+        }
+        ++m_prefetch.count;
+        m_prefetch.notEmpty.notify_one();
+    }
+}
+
+void OpenCVPlayer::enableLiveMode()
+{
+    if ( (m_inputType != InputType::LIVESTREAM && m_inputType != InputType::WEBCAM) || !m_capture.isOpened() )
+    {
+        return;
+    }
+
+    disablePrefetch();
+    disableLiveMode();
+
+    /* Some backends honour it, the grab thread takes care of the rest */
+    m_capture.set(cv::CAP_PROP_BUFFERSIZE, 1);
+
+    m_live.skipped = 0;
+    m_live.frameNum = m_frameNum;
+    m_live.enabled = true;
+    startLiveThread();
+}
+
+void OpenCVPlayer::disableLiveMode()
+{
+    if ( !m_live.enabled )
+    {
+        return;
+    }
+
+    stopLiveThread();
+    m_live.enabled = false;
+}
+
+bool OpenCVPlayer::liveMode() const noexcept
+{
+    return m_live.enabled;
+}
+
+std::int64_t OpenCVPlayer::skippedFrames() const noexcept
+{
+    return m_live.skipped;
+}
+
+void OpenCVPlayer::startLiveThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_live.mutex);
+        m_live.consumers = 0;
+        m_live.fresh = false;
+        m_live.stop = false;
+        m_live.eof = false;
+    }
+    m_live.thread = std::thread(&OpenCVPlayer::liveLoop, this);
+}
+
+void OpenCVPlayer::stopLiveThread()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_live.mutex);
+        m_live.stop = true;
+    }
+    m_live.taken.notify_all();
+    if ( m_live.thread.joinable() )
+    {
+        m_live.thread.join();
+    }
+}
+
+bool OpenCVPlayer::takeLiveFrame(std::unique_lock<std::mutex>& captureLock)
+{
+    /* std::mutex is not fair, so the grabber is told to let us in rather than racing it for the capture */
+    {
+        std::lock_guard<std::mutex> lock(m_live.mutex);
+        ++m_live.consumers;
+    }
+    captureLock.lock();
+
+    /* The grabber needs m_captureMutex to grab, so the frame does not change under the caller while it holds it */
+    std::unique_lock<std::mutex> lock(m_live.mutex);
+    while ( !m_live.fresh && !m_live.eof )
+    {
+        captureLock.unlock();
+        m_live.notEmpty.wait(lock, [this]{ return m_live.fresh || m_live.eof; });
+        lock.unlock();
+        captureLock.lock();
+        lock.lock();
+    }
+
+    const bool fresh = m_live.fresh;
+    if ( fresh )
+    {
+        m_live.fresh = false;
+        m_frameNum = m_live.frameNum;
+        m_liveTimestamp = m_live.timestamp;
+    }
+    --m_live.consumers;
+    m_live.taken.notify_one();
+    return fresh;
+}
+
+void OpenCVPlayer::liveLoop()
+{
+    pinToBudget(threadBudget().opencv.cores);
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    bool ptsValid = true;
+    double firstPts = -1.0;
+    double lastPts = -1.0;
+    std::int64_t lastTimestamp = 0;
+    std::int64_t clockBase = 0;
+
+    while ( true )
+    {
+        {
+            /* A consumer waiting for the fresh frame gets the capture before the next grab */
+            std::unique_lock<std::mutex> lock(m_live.mutex);
+            m_live.taken.wait(lock, [this]{ return m_live.stop || !m_live.fresh || m_live.consumers == 0; });
+            if ( m_live.stop )
+            {
+                break;
+            }
+        }
+
+        /* Frames are only grabbed here, the consumer decodes the one it takes */
+        std::lock_guard<std::mutex> captureLock(m_captureMutex);
+        const bool grabbed = m_capture.grab();
+        const double pts = m_capture.get(cv::CAP_PROP_POS_MSEC);
+        const std::int64_t elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - start).count();
+
+        /* Stream PTS while it keeps increasing, then continue with the capture clock */
+        std::int64_t timestamp = 0;
+        if ( ptsValid && pts > lastPts )
+        {
+            firstPts = ( firstPts < 0.0 ) ? pts : firstPts;
+            timestamp = static_cast<std::int64_t>(pts - firstPts);
+            lastPts = pts;
+        }
+        else
+        {
+            if ( ptsValid )
+            {
+                ptsValid = false;
+                clockBase = lastTimestamp - elapsedMs;
+            }
+            timestamp = elapsedMs + clockBase;
+        }
+        lastTimestamp = timestamp;
+
+        std::lock_guard<std::mutex> lock(m_live.mutex);
+        if ( !grabbed )
+        {
+            m_live.eof = true;
+            m_live.notEmpty.notify_all();
+            break;
+        }
+        if ( m_live.fresh )
+        {
+            ++m_live.skipped;
+        }
+        m_live.fresh = true;
+        ++m_live.frameNum;
+        m_live.timestamp = timestamp;
+        m_live.notEmpty.notify_one();
+    }
+}
+
+}
@@ -3,6 +3,36 @@
 namespace cvt
 {
 
+bool Detector::OutputData::detailedFrame(cv::Size size, cv::Mat& out) const
+{
+    if ( !eventFrame )
+    {
+        return false;
+    }
+
+    const cv::Mat* plane = eventFrame->planes.find(PlaneSpec::Format::BGR, size);
+    if ( plane )
+    {
+        plane->copyTo(out);
+    }
+    else if ( eventFrame->image.size() == size )
+    {
+        eventFrame->image.copyTo(out);
+    }
+    else
+    {
+        cv::resize(eventFrame->image, out, size);
+    }
+    if ( out.channels() == 1 )
+    {
+        cv::cvtColor(out, out, cv::COLOR_GRAY2BGR);
+    }
+
+    drawInferOuts(out, eventInferOuts, cv::Scalar::all(0), false, true);
+    return true;
+}
+
+
 DetectorSettings::DetectorSettings(const Detector::InitializeData& iData, const json& jSettings)
     : m_instanceName(iData.instanceName)
     , m_detectorResolution(iData.imSize)
@@ -18,6 +48,7 @@ DetectorSettings::DetectorSettings(const Detector::InitializeData& iData, const
     {
         m_areas.emplace_back( cvt::createFullScreenArea(m_detectorResolution) );
     }
+    m_areaMask = AreaMask(m_areas, m_detectorResolution);
 }
 
 cv::Size DetectorSettings::detectorResolution() const noexcept
@@ -30,9 +61,14 @@ double DetectorSettings::fps() const noexcept
     return m_fps;
 }
 
+const SamplingSettings& DetectorSettings::sampling() const noexcept
+{
+    return m_sampling;
+}
+
 std::int64_t DetectorSettings::processFreqMs() const noexcept
 {
-    return m_processFreqMs;
+    return m_sampling.periodMs;
 }
 
 const Areas& DetectorSettings::areas() const noexcept
@@ -40,11 +76,46 @@ const Areas& DetectorSettings::areas() const noexcept
     return m_areas;
 }
 
+const AreaMask& DetectorSettings::areaMask() const noexcept
+{
+    return m_areaMask;
+}
+
 bool DetectorSettings::displayDetailed() const noexcept
 {
     return m_displayDetailed;
 }
 
+const AdmissionSettings& DetectorSettings::admission() const noexcept
+{
+    return m_admission;
+}
+
+int DetectorSettings::pipelineDepth() const noexcept
+{
+    return m_pipelineDepth;
+}
+
+int DetectorSettings::batchSize() const noexcept
+{
+    return m_batchSize;
+}
+
+bool DetectorSettings::cropToAreas() const noexcept
+{
+    return m_cropToAreas;
+}
+
+const std::string& DetectorSettings::snapshotPath() const noexcept
+{
+    return m_snapshotPath;
+}
+
+std::int64_t DetectorSettings::snapshotPeriodMs() const noexcept
+{
+    return m_snapshotPeriodMs;
+}
+
 void DetectorSettings::parseCommonJsonSettings(const json& j)
 {
     auto jDetectorSettings = j[m_instanceName];
@@ -57,12 +128,35 @@ void DetectorSettings::parseCommonJsonSettings(const json& j)
     if ( !jDetectorSettings["detector-resolution"].empty() )
         m_detectorResolution = cvt::parseResolution(jDetectorSettings["detector-resolution"]);
     
+    std::int64_t processFreqMs = 0;
     if ( !jDetectorSettings["process-freq-ms"].empty() )
-        m_processFreqMs = static_cast<std::int64_t>(jDetectorSettings["process-freq-ms"]);
+        processFreqMs = static_cast<std::int64_t>(jDetectorSettings["process-freq-ms"]);
+    m_sampling = SamplingSettings::fromJson(jDetectorSettings["sampling"], processFreqMs);
         
     if ( !jDetectorSettings["display-detailed"].empty() )
         m_displayDetailed = static_cast<bool>(jDetectorSettings["display-detailed"]);
 
+    if ( !jDetectorSettings["max-frame-age-ms"].empty() )
+        m_admission.maxFrameAgeMs = static_cast<std::int64_t>(jDetectorSettings["max-frame-age-ms"]);
+
+    if ( !jDetectorSettings["adaptive-admission"].empty() )
+        m_admission.adaptive = static_cast<bool>(jDetectorSettings["adaptive-admission"]);
+
+    if ( !jDetectorSettings["pipeline-depth"].empty() )
+        m_pipelineDepth = std::max(1, static_cast<int>(jDetectorSettings["pipeline-depth"]));
+
+    if ( !jDetectorSettings["batch-size"].empty() )
+        m_batchSize = std::max(1, static_cast<int>(jDetectorSettings["batch-size"]));
+
+    if ( !jDetectorSettings["crop-to-areas"].empty() )
+        m_cropToAreas = static_cast<bool>(jDetectorSettings["crop-to-areas"]);
+
+    if ( !jDetectorSettings["snapshot-path"].empty() )
+        m_snapshotPath = jDetectorSettings["snapshot-path"];
+
+    if ( !jDetectorSettings["snapshot-period-ms"].empty() )
+        m_snapshotPeriodMs = static_cast<std::int64_t>(jDetectorSettings["snapshot-period-ms"]);
+
     m_areas = cvt::parseAreas(jDetectorSettings["areas"], m_detectorResolution);
 }
 
@@ -0,0 +1,366 @@
+#include "cvtoolkit/detector/cascade_detector.hpp"
+#include "cvtoolkit/detector/optflow_motion_detector.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+
+
+namespace cvt
+{
+
+CascadeDetectorSettings::CascadeDetectorSettings(const Detector::InitializeData& iData, const json& jSettings)
+    : DetectorSettings(iData, jSettings)
+{
+    if ( !jSettings.empty() )
+    {
+        parseJsonSettings(jSettings);
+    }
+}
+
+void CascadeDetectorSettings::parseJsonSettings(const json& j)
+{
+    auto jDetectorSettings = j[m_instanceName];
+    if ( jDetectorSettings.empty() )
+    {
+        std::cerr << ">>> Could not find " << m_instanceName << " section" << std::endl;
+        return;
+    }
+
+    if ( !jDetectorSettings["gate"].empty() )
+    {
+        const std::string gate = jDetectorSettings["gate"];
+        if ( gate == "optflow-motion-detector" )
+        {
+            m_gate = Gate::OPTFLOW;
+        }
+        else if ( gate != "frame-diff" )
+        {
+            std::cerr << ">>> [CascadeDetectorSettings] Unknown gate \"" << gate << "\", frame-diff is used" << std::endl;
+        }
+    }
+
+    if ( !jDetectorSettings["diff-threshold"].empty() )
+        m_diffThreshold = static_cast<int>(jDetectorSettings["diff-threshold"]);
+
+    if ( !jDetectorSettings["motion-threshold"].empty() )
+        m_motionThreshold = static_cast<double>(jDetectorSettings["motion-threshold"]);
+
+    if ( !jDetectorSettings["hold-open-ms"].empty() )
+        m_holdOpenMs = static_cast<std::int64_t>(jDetectorSettings["hold-open-ms"]);
+
+    if ( !jDetectorSettings["per-area"].empty() )
+        m_perArea = static_cast<bool>(jDetectorSettings["per-area"]);
+}
+
+int CascadeDetectorSettings::gate() const noexcept
+{
+    return m_gate;
+}
+
+int CascadeDetectorSettings::diffThreshold() const noexcept
+{
+    return m_diffThreshold;
+}
+
+double CascadeDetectorSettings::motionThreshold() const noexcept
+{
+    return m_motionThreshold;
+}
+
+std::int64_t CascadeDetectorSettings::holdOpenMs() const noexcept
+{
+    return m_holdOpenMs;
+}
+
+bool CascadeDetectorSettings::perArea() const noexcept
+{
+    return m_perArea;
+}
+
+
+CascadeDetector::CascadeDetector(const Detector::InitializeData& iData, const std::shared_ptr<Detector>& detector,
+                                 const std::shared_ptr<Detector>& gate)
+    : m_detector(detector)
+    , m_gate(gate)
+    , m_imSize(iData.imSize)
+{
+    json jSettings = makeJsonObject(iData.settingsPath);
+    m_settings = std::make_shared<CascadeDetectorSettings>(iData, jSettings);
+    m_sampling = std::make_unique<SamplingPolicy>(m_settings->sampling());
+
+    if ( !m_gate && m_settings->gate() == CascadeDetectorSettings::Gate::OPTFLOW )
+    {
+        Detector::InitializeData gateData { "optflow-motion-detector", iData.imSize, iData.fps, iData.settingsPath };
+        m_gate = std::make_shared<OptflowMotionDetector>(gateData);
+    }
+    m_optflowGate = dynamic_cast<OptflowMotionDetector*>(m_gate.get());
+
+    /* Handle with area masks */
+    if ( m_settings->perArea() )
+    {
+        for ( const auto& area : m_settings->areas() )
+        {
+            m_areaMasks.emplace_back(Areas{ area }, m_settings->detectorResolution());
+        }
+    }
+    else
+    {
+        m_areaMasks.emplace_back(m_settings->areaMask());
+    }
+
+    m_metrics = std::make_shared<cvt::MetricMaster>();
+}
+
+CascadeDetector::~CascadeDetector()
+{
+    if ( m_metrics )
+    {
+        std::cout << ">>> [CascadeDetector] gate metrics: " << m_metrics->summary() << std::endl;
+    }
+    std::cout << ">>> [CascadeDetector] " << m_passedFrames << " of " << m_gatedFrames
+              << " frames passed to the detector, skip ratio " << skipRatio() << std::endl;
+    std::cout << ">>> [CascadeDetector] " << m_sampling->summary() << std::endl;
+}
+
+void CascadeDetector::process(const Detector::InputData& in, Detector::OutputData& out)
+{
+    out.reset();
+    if ( !open(in) )
+    {
+        return;
+    }
+    m_detector->process(in, out);
+    m_sampling->observe(in.timestamp, out.event);
+}
+
+void CascadeDetector::processBatch(const std::vector<Detector::InputData>& in, std::vector<Detector::OutputData>& out)
+{
+    out.resize(in.size());
+    for ( auto& o : out )
+    {
+        o.reset();
+    }
+
+    /* Only the frames the gate lets through make up the batch */
+    auto& owners = m_openOwners;
+    owners.clear();
+    m_openIn.clear();
+    for ( size_t i = 0; i < in.size(); ++i )
+    {
+        if ( open(in[i]) )
+        {
+            owners.emplace_back(i);
+            m_openIn.emplace_back(in[i]);
+        }
+    }
+    if ( m_openIn.empty() )
+    {
+        return;
+    }
+
+    m_detector->processBatch(m_openIn, m_openOut);
+    for ( size_t k = 0; k < owners.size() && k < m_openOut.size(); ++k )
+    {
+        m_sampling->observe(m_openIn[k].timestamp, m_openOut[k].event);
+        std::swap(out[owners[k]], m_openOut[k]); // outputs keep their buffers
+    }
+    m_openIn.clear();
+}
+
+void CascadeDetector::preprocess(Detector::Job& job)
+{
+    if ( !open(job.in) )
+    {
+        job.skip = true;
+        return;
+    }
+    m_detector->preprocess(job);
+}
+
+void CascadeDetector::infer(Detector::Job& job)
+{
+    m_detector->infer(job);
+}
+
+void CascadeDetector::postprocess(Detector::Job& job)
+{
+    m_detector->postprocess(job);
+    m_sampling->observe(job.in.timestamp, job.out.event);
+}
+
+PlaneSpecs CascadeDetector::requiredPlanes() const
+{
+    PlaneSpecs specs;
+    if ( !m_gate )
+    {
+        specs.emplace_back(PlaneSpec{ PlaneSpec::Format::GRAY, m_settings->detectorResolution() });
+    }
+
+    const PlaneSpecs gateSpecs = m_gate ? m_gate->requiredPlanes() : PlaneSpecs();
+    const PlaneSpecs detectorSpecs = m_detector->requiredPlanes();
+    for ( const PlaneSpecs* other : { &gateSpecs, &detectorSpecs } )
+    {
+        for ( const auto& spec : *other )
+        {
+            if ( std::find(specs.begin(), specs.end(), spec) == specs.end() )
+            {
+                specs.emplace_back(spec);
+            }
+        }
+    }
+    return specs;
+}
+
+bool CascadeDetector::saveState(SnapshotWriter& snapshot) const
+{
+    /* Either part may have no state, so each one goes into its own (possibly empty) section */
+    bool saved = false;
+    for ( const Detector* part : { m_gate.get(), m_detector.get() } )
+    {
+        SnapshotWriter section;
+        if ( part && part->saveState(section) )
+        {
+            saved = true;
+        }
+        else
+        {
+            section.clear();
+        }
+        snapshot.write(section);
+    }
+    return saved;
+}
+
+bool CascadeDetector::loadState(SnapshotReader& snapshot)
+{
+    bool loaded = true;
+    for ( Detector* part : { m_gate.get(), m_detector.get() } )
+    {
+        SnapshotReader section;
+        if ( !snapshot.read(section) )
+        {
+            return false;
+        }
+        if ( part && !section.atEnd() )
+        {
+            loaded = part->loadState(section) && loaded;
+        }
+    }
+    return loaded;
+}
+
+double CascadeDetector::skipRatio() const noexcept
+{
+    const std::int64_t gated = m_gatedFrames;
+    return ( gated > 0 ) ? 1.0 - static_cast<double>(m_passedFrames) / static_cast<double>(gated) : 0.0;
+}
+
+std::int64_t CascadeDetector::gatedFrames() const noexcept
+{
+    return m_gatedFrames;
+}
+
+std::int64_t CascadeDetector::passedFrames() const noexcept
+{
+    return m_passedFrames;
+}
+
+const std::shared_ptr<CascadeDetectorSettings>& CascadeDetector::settings() const noexcept
+{
+    return m_settings;
+}
+
+const std::shared_ptr<Detector>& CascadeDetector::detector() const noexcept
+{
+    return m_detector;
+}
+
+bool CascadeDetector::open(const Detector::InputData& in)
+{
+    ++m_gatedFrames;
+    if ( !m_sampling->admit(in.timestamp, in.keyframe) )
+    {
+        return false;
+    }
+
+    bool motion = false;
+    {
+        auto m = m_metrics->measure();
+        if ( m_gate )
+        {
+            /* The optical flow detector raises its event once per motion, so its trigger state tells more */
+            m_gateOut.reset();
+            m_gate->process(in, m_gateOut);
+            motion = m_optflowGate ? m_optflowGate->motionOn() : m_gateOut.event;
+        }
+        else
+        {
+            motion = frameDiffMotion(in);
+        }
+    }
+
+    if ( motion )
+    {
+        m_lastMotionMs = in.timestamp;
+    }
+    else if ( m_lastMotionMs < 0 || in.timestamp - m_lastMotionMs > m_settings->holdOpenMs() )
+    {
+        return false;
+    }
+
+    ++m_passedFrames;
+    return true;
+}
+
+bool CascadeDetector::frameDiffMotion(const Detector::InputData& in)
+{
+    const cv::Mat* grayPlane = ( in.frame )
+                            ? in.frame->planes.find(PlaneSpec::Format::GRAY, m_settings->detectorResolution())
+                            : nullptr;
+    if ( grayPlane )
+    {
+        grayPlane->copyTo(m_gray); // the pooled plane is recycled, but m_gray is kept as the previous frame
+    }
+    else
+    {
+        const cv::Mat frame = cv::Mat(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
+        cv::cvtColor(frame, m_gray, cv::COLOR_BGR2GRAY);
+        if ( m_settings->detectorResolution() != m_imSize )
+        {
+            cv::resize(m_gray, m_gray, m_settings->detectorResolution(), 0.0, 0.0, cv::INTER_AREA);
+        }
+    }
+
+    /* The first frame always goes through, so objects already in the scene get detected */
+    if ( m_prevGray.empty() )
+    {
+        m_prevGray = m_gray.clone();
+        return true;
+    }
+
+    /* Changed pixels are counted only within the areas */
+    bool motion = false;
+    const int diffThreshold = m_settings->diffThreshold();
+    for ( const auto& mask : m_areaMasks )
+    {
+        int changed = 0;
+        mask.forEachSpan([&](int y, const Span& span)
+        {
+            const uchar* curr = m_gray.ptr<uchar>(y);
+            const uchar* prev = m_prevGray.ptr<uchar>(y);
+            for ( int x = span.x; x < span.end; ++x )
+            {
+                changed += ( std::abs(curr[x] - prev[x]) > diffThreshold );
+            }
+        });
+        if ( mask.area() > 0 && changed >= m_settings->motionThreshold() * mask.area() )
+        {
+            motion = true;
+            break;
+        }
+    }
+    cv::swap(m_gray, m_prevGray);
+    return motion;
+}
+
+}
@@ -1,9 +1,105 @@
 #include "cvtoolkit/detector/optflow_motion_detector.hpp"
 
+#include <cmath>
+#include <limits>
+
 
 namespace cvt
 {
 
+namespace
+{
+
+/* Counts moving in-zone pixels of the flow in a single pass. Zone rows are split into stripes and every stripe
+   has its own counters, so no synchronization is needed */
+class MotionEnergyBody final : public cv::ParallelLoopBody
+{
+public:
+    MotionEnergyBody(const cv::Mat& flow, const AreaMask& zone, float minVelocity, float maxVelocity, int stripeRows,
+                     int* moving, int* hist, int bins, cv::Mat* motion)
+        : m_flow(flow)
+        , m_zone(zone)
+        , m_stripeRows(stripeRows)
+        , m_moving(moving)
+        , m_hist(hist)
+        , m_bins(bins)
+        , m_motion(motion)
+    {
+        /* Squared magnitudes are compared, so no square roots are taken */
+        m_min2 = ( minVelocity > 0.0f ) ? minVelocity * minVelocity : 0.0f;
+        m_max2 = ( maxVelocity > 0.0f ) ? maxVelocity * maxVelocity : std::numeric_limits<float>::infinity();
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        const float min2 = m_min2;
+        const float max2 = m_max2;
+        const float binsPerRad = static_cast<float>(m_bins / (2.0 * CV_PI));
+        for ( int s = range.start; s < range.end; ++s )
+        {
+            const int yBegin = m_zone.boundingRect().y + s * m_stripeRows;
+            int* hist = m_hist ? m_hist + s * m_bins : nullptr;
+            int moving = 0;
+            m_zone.forEachSpan(yBegin, yBegin + m_stripeRows, [&](int y, const Span& span)
+            {
+                const float* f = m_flow.ptr<float>(y);
+                if ( !hist && !m_motion )
+                {
+                    /* The common case is kept branch-free for the compiler to vectorize */
+                    for ( int x = span.x; x < span.end; ++x )
+                    {
+                        const float m2 = f[2 * x] * f[2 * x] + f[2 * x + 1] * f[2 * x + 1];
+                        moving += ( m2 > min2 ) & ( m2 <= max2 );
+                    }
+                    return;
+                }
+
+                uchar* mask = m_motion ? m_motion->ptr<uchar>(y) : nullptr;
+                for ( int x = span.x; x < span.end; ++x )
+                {
+                    const float u = f[2 * x];
+                    const float v = -f[2 * x + 1]; // image y axis looks down
+                    const float m2 = u * u + v * v;
+                    const bool isMoving = ( m2 > min2 ) && ( m2 <= max2 );
+                    if ( mask )
+                    {
+                        mask[x] = isMoving ? 255 : 0;
+                    }
+                    if ( !isMoving )
+                    {
+                        continue;
+                    }
+                    ++moving;
+                    if ( hist )
+                    {
+                        float angle = std::atan2(v, u);
+                        if ( angle < 0.0f )
+                        {
+                            angle += static_cast<float>(2.0 * CV_PI);
+                        }
+                        ++hist[std::min(m_bins - 1, static_cast<int>(angle * binsPerRad))];
+                    }
+                }
+            });
+            m_moving[s] = moving;
+        }
+    }
+
+private:
+    const cv::Mat& m_flow;
+    const AreaMask& m_zone;
+    float m_min2;
+    float m_max2;
+    int m_stripeRows;
+    int* m_moving;
+    int* m_hist;
+    int m_bins;
+    cv::Mat* m_motion;
+};
+
+}
+
+
 OptflowMotionDetectorSettings::OptflowMotionDetectorSettings(const Detector::InitializeData& iData, const json& jSettings)
     : DetectorSettings(iData, jSettings)
 {
@@ -34,6 +130,9 @@ void OptflowMotionDetectorSettings::parseJsonSettings(const json& j)
     if ( !jDetectorSettings["alert-holddown-ms"].empty() )
         m_eventHolddownMs = static_cast<std::int64_t>(jDetectorSettings["alert-holddown-ms"]);
     
+    if ( !jDetectorSettings["direction-bins"].empty() )
+        m_directionBins = std::max(0, static_cast<int>(jDetectorSettings["direction-bins"]));
+    
     if ( !jDetectorSettings["--advanced--alert-holdout-ms"].empty() )
         m_eventHoldoutMs = static_cast<std::int64_t>(jDetectorSettings["--advanced--alert-holdout-ms"]);
 }
@@ -63,19 +162,26 @@ const std::int64_t OptflowMotionDetectorSettings::eventHolddownMs() const noexce
     return m_eventHolddownMs;
 }
 
+int OptflowMotionDetectorSettings::directionBins() const noexcept
+{
+    return m_directionBins;
+}
+
 
 OptflowMotionDetector::OptflowMotionDetector(const Detector::InitializeData& iData)
     : m_imSize(iData.imSize)
 {
     json jSettings = makeJsonObject(iData.settingsPath);
     m_settings = std::make_shared<OptflowMotionDetectorSettings>(iData, jSettings);
+    m_sampling = std::make_unique<SamplingPolicy>(m_settings->sampling());
 
-    m_FlowAreaMask = cv::Mat::zeros(m_settings->detectorResolution(), CV_32FC2);
-    m_Motion = cv::Mat::zeros(m_settings->detectorResolution(), CV_8U);
-
-    cv::drawContours(m_FlowAreaMask, m_settings->areas(), -1, cv::Scalar::all(255), -1);
-    const int totalArea = totalSqArea(m_settings->areas());
-    m_maxMotion = static_cast<double>(255 * totalArea);
+    /* Handle with motion energy. Several stripes per thread even out the uneven spans of the zone */
+    const int zoneRows = m_settings->areaMask().boundingRect().height;
+    const int stripes = std::max(1, std::min(zoneRows, 4 * cv::getNumThreads()));
+    m_stripeRows = std::max(1, (zoneRows + stripes - 1) / stripes);
+    m_stripeMoving.assign(stripes, 0);
+    m_stripeHist.assign(stripes * m_settings->directionBins(), 0);
+    m_directionHist.assign(m_settings->directionBins(), 0);
 
     /* Handle with optical flow */
 #if CV_MAJOR_VERSION == 3
@@ -96,16 +202,26 @@ OptflowMotionDetector::OptflowMotionDetector(const Detector::InitializeData& iDa
 
 void OptflowMotionDetector::process(const Detector::InputData& in, Detector::OutputData& out)
 {
-    if ( filterByTimestamp(in.timestamp) )
+    if ( !m_sampling->admit(in.timestamp, in.keyframe) )
     {
         return;
     }
 
-    const cv::Mat frame = cv::Mat(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
-    cv::cvtColor(frame, m_Gray, cv::COLOR_BGR2GRAY);
-    if ( m_settings->detectorResolution() != m_imSize )
+    const cv::Mat* grayPlane = ( in.frame ) 
+                            ? in.frame->planes.find(PlaneSpec::Format::GRAY, m_settings->detectorResolution()) 
+                            : nullptr;
+    if ( grayPlane )
+    {
+        grayPlane->copyTo(m_Gray); // the pooled plane is recycled, but m_Gray is kept as the previous frame
+    }
+    else
     {
-        cv::resize(m_Gray, m_Gray, m_settings->detectorResolution(), 0.0, 0.0, cv::INTER_AREA);
+        const cv::Mat frame = cv::Mat(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
+        cv::cvtColor(frame, m_Gray, cv::COLOR_BGR2GRAY);
+        if ( m_settings->detectorResolution() != m_imSize )
+        {
+            cv::resize(m_Gray, m_Gray, m_settings->detectorResolution(), 0.0, 0.0, cv::INTER_AREA);
+        }
     }
         
     if ( m_PrevGray.empty() )
@@ -120,32 +236,15 @@ void OptflowMotionDetector::process(const Detector::InputData& in, Detector::Out
         
     /* 1. Calculate flow */
     m_disOpt->calc(m_Gray, m_PrevGray, m_Flow);
-    cv::bitwise_and(m_Flow, m_FlowAreaMask, m_Flow);
 
-    /* 2. Get magnitude */
-    cv::split(m_Flow, m_FlowUV);
-    cv::multiply(m_FlowUV[1], -1, m_FlowUV[1]);
-    cv::cartToPolar(m_FlowUV[0], m_FlowUV[1], m_FlowMagn, m_FlowAngle, true);
-
-    /* 3. Threshold */
-    if ( m_settings->maxAcceptedVelocity() > 0.0 && m_settings->maxAcceptedVelocity() < 255 )
-    {
-        cv::threshold(m_FlowMagn, m_Motion, 0, m_settings->maxAcceptedVelocity(), cv::THRESH_BINARY);
-    }
-    if ( m_settings->minAcceptedVelocity() > 0.0 )
-    {
-        cv::threshold(m_FlowMagn, m_Motion, m_settings->minAcceptedVelocity(), 255, cv::THRESH_BINARY);
-    }
-
-    // cv::Mat m_Motion2;
-    // motionMask_experimental(m_Flow, m_Motion2);
-
-    /* 4. Make decision */
-    double totalMotion = cv::sum(m_Motion)[0] / m_maxMotion;
+    /* 2. Count moving pixels within the areas */
+    const double totalMotion = static_cast<double>(motionEnergy()) / std::max(1, m_settings->areaMask().area());
 
+    /* 3. Make decision */
     m_motionGaussian->observe(totalMotion);
 
     int event = m_eventTrigger( (totalMotion >= m_settings->decisionThresh()) );
+    m_sampling->observe(in.timestamp, event == EventTrigger::State::ON || event == EventTrigger::State::ABOUT_TO_ON);
     if ( event == EventTrigger::State::ABOUT_TO_ON )
     {
         out.event = true;
@@ -160,6 +259,49 @@ void OptflowMotionDetector::process(const Detector::InputData& in, Detector::Out
     cv::swap(m_Gray, m_PrevGray);
 }
 
+bool OptflowMotionDetector::motionOn() const noexcept
+{
+    return m_eventTrigger.state() != 0;
+}
+
+PlaneSpecs OptflowMotionDetector::requiredPlanes() const
+{
+    return { PlaneSpec{ PlaneSpec::Format::GRAY, m_settings->detectorResolution() } };
+}
+
+bool OptflowMotionDetector::saveState(SnapshotWriter& snapshot) const
+{
+    /* The motion statistics depend on the resolution the flow is computed at */
+    snapshot.write(static_cast<std::int32_t>(m_settings->detectorResolution().width));
+    snapshot.write(static_cast<std::int32_t>(m_settings->detectorResolution().height));
+    snapshot.write(m_motionGaussian->mean());
+    snapshot.write(m_motionGaussian->stdev2());
+    snapshot.write(static_cast<std::int32_t>(m_eventTrigger.counter()));
+    snapshot.write(static_cast<std::int32_t>(m_eventTrigger.state()));
+    return true;
+}
+
+bool OptflowMotionDetector::loadState(SnapshotReader& snapshot)
+{
+    std::int32_t width = 0, height = 0;
+    double mean = 0.0, stdev2 = 1.0;
+    std::int32_t counter = 0, state = 0;
+    snapshot.read(width);
+    snapshot.read(height);
+    snapshot.read(mean);
+    snapshot.read(stdev2);
+    snapshot.read(counter);
+    snapshot.read(state);
+    if ( !snapshot.good() || cv::Size(width, height) != m_settings->detectorResolution() )
+    {
+        return false;
+    }
+
+    m_motionGaussian->restore(mean, stdev2);
+    m_eventTrigger.restore(counter, state != 0);
+    return true;
+}
+
 const cv::Mat& OptflowMotionDetector::flow() const noexcept
 {
     return m_Flow;
@@ -170,64 +312,63 @@ const cv::Mat& OptflowMotionDetector::motion() const noexcept
     return m_Motion;
 }
 
-const std::shared_ptr<OptflowMotionDetectorSettings>& OptflowMotionDetector::settings() const noexcept
+void OptflowMotionDetector::setMotionMaskEnabled(bool enabled) noexcept
 {
-    return m_settings;
+    m_motionMaskEnabled = enabled;
 }
 
-bool OptflowMotionDetector::filterByTimestamp(std::int64_t timestamp)
+const std::vector<int>& OptflowMotionDetector::directionHistogram() const noexcept
 {
-    if ( m_settings->processFreqMs() <= 0 ) return false;
-    
-    if ( m_lastProcessedFrameMs == -1 )
+    return m_directionHist;
+}
+
+int OptflowMotionDetector::motionEnergy()
+{
+    const AreaMask& areaMask = m_settings->areaMask();
+    if ( areaMask.empty() )
     {
-        m_lastProcessedFrameMs = timestamp;
+        return 0;
     }
-    else
+
+    cv::Mat* motion = nullptr;
+    if ( m_motionMaskEnabled )
     {
-        if ( m_settings->processFreqMs() > 0 )
+        if ( m_Motion.size() != m_Flow.size() )
         {
-            std::int64_t elapsed = timestamp - m_lastProcessedFrameMs;
-            if ( elapsed < m_settings->processFreqMs() )
+            m_Motion = cv::Mat::zeros(m_Flow.size(), CV_8U); // out-of-zone pixels are never written
+        }
+        motion = &m_Motion;
+    }
+
+    const int bins = m_settings->directionBins();
+    const int stripes = static_cast<int>(m_stripeMoving.size());
+    cv::parallel_for_(cv::Range(0, stripes), MotionEnergyBody(m_Flow, areaMask, 
+        m_settings->minAcceptedVelocity(), m_settings->maxAcceptedVelocity(), m_stripeRows, 
+        m_stripeMoving.data(), ( bins > 0 ) ? m_stripeHist.data() : nullptr, bins, motion));
+
+    int moving = 0;
+    for ( int s = 0; s < stripes; ++s )
+    {
+        moving += m_stripeMoving[s];
+    }
+    if ( bins > 0 )
+    {
+        std::fill(m_directionHist.begin(), m_directionHist.end(), 0);
+        for ( int s = 0; s < stripes; ++s )
+        {
+            for ( int b = 0; b < bins; ++b )
             {
-                return true;
+                m_directionHist[b] += m_stripeHist[s * bins + b];
             }
-            m_lastProcessedFrameMs = timestamp - (timestamp % m_settings->processFreqMs());
         }
+        std::fill(m_stripeHist.begin(), m_stripeHist.end(), 0);
     }
-
-    return false;
+    return moving;
 }
 
-// void motionMask_experimental(const cv::Mat& flow, cv::Mat& out)
-// {
-//     if ( out.empty() )
-//     {
-//         out.create(flow.size(), CV_8U);
-//     }
-//     out.setTo(cv::Scalar(0));
-
-//     cv::parallel_for_(cv::Range(0, flow.rows * flow.cols), [&](const cv::Range& range)
-//     {
-//         for ( int r = range.start; r < range.end; ++r )
-//         {
-//             int i = r / flow.cols;
-//             int j = r % flow.cols;
-
-//             const auto maskPixel = m_FlowAreaMask.at<cv::Point2f>(i, j);
-//             if ( maskPixel.x * maskPixel.y == 0.0 ) continue;
-
-//             const auto uu = -flow.at<cv::Point2f>(i, j);
-//             if ( !isFlowCorrect(uu) ) continue;
-
-//             const cv::Vec2f vv = cv::Vec2f(uu.x, uu.y);
-//             const double magn = cv::norm(vv);
-
-//             if ( magn < m_settings->minAcceptedVelocity() ) continue;
-
-//             out.at<uchar>(i, j) = 255;
-//         }
-//     });
-// }
+const std::shared_ptr<OptflowMotionDetectorSettings>& OptflowMotionDetector::settings() const noexcept
+{
+    return m_settings;
+}
 
 }
\ No newline at end of file
@@ -65,6 +65,7 @@ YOLOObjectDetector::YOLOObjectDetector(const Detector::InitializeData& iData)
 {
     json jSettings = makeJsonObject(iData.settingsPath);
     m_settings = std::make_shared<YOLOObjectDetectorSettings>(iData, jSettings);
+    m_sampling = std::make_unique<SamplingPolicy>(m_settings->sampling());
 
     const std::string wPath = m_settings->yoloPath() + "/yolo.weights";
     const std::string cPath = m_settings->yoloPath() + "/yolo.cfg";
@@ -82,6 +83,8 @@ YOLOObjectDetector::YOLOObjectDetector(const Detector::InitializeData& iData)
         }
     }
 
+    initCrops();
+
     m_metrics = std::make_shared<cvt::MetricMaster>();
 }
 
@@ -91,28 +94,184 @@ YOLOObjectDetector::~YOLOObjectDetector()
     {
         std::cout << ">>> [YOLOObjectDetector] metrics: " << m_metrics->summary() << std::endl;
     }
+    std::cout << ">>> [YOLOObjectDetector] " << m_sampling->summary() << std::endl;
 }
 
 void YOLOObjectDetector::process(const Detector::InputData& in, Detector::OutputData& out)
 {
     if ( m_yoloDetector->empty() ) return;
 
-    if ( filterByTimestamp(in.timestamp) )
+    auto m = m_metrics->measure();
+
+    /* The job borrows the buffers of the output */
+    Detector::Job job;
+    job.in = in;
+    job.out = std::move(out);
+    job.out.reset();
+    preprocess(job);
+    if ( !job.skip )
     {
-        return;
+        infer(job);
+        postprocess(job);
     }
+    out = std::move(job.out);
+}
+
+void YOLOObjectDetector::processBatch(const std::vector<Detector::InputData>& in, std::vector<Detector::OutputData>& out)
+{
+    out.resize(in.size());
+    for ( auto& o : out )
+    {
+        o.reset();
+    }
+    if ( m_yoloDetector->empty() ) return;
 
     auto m = m_metrics->measure();
 
-    cv::Mat frame = cv::Mat(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
+    /* Every frame contributes either itself or its area crops to one common batch */
+    Scratch& s = m_batchScratch;
+    auto& owners = s.owners;
+    auto& detInputs = s.detInputs;
+    auto& inputs = s.inputs;
+    owners.clear();
+    inputs.clear();
+    detInputs.resize(in.size());
+    for ( size_t i = 0; i < in.size(); ++i )
+    {
+        if ( !m_sampling->admit(in[i].timestamp, in[i].keyframe) )
+        {
+            continue;
+        }
+
+        detInputs[i] = prepareInput(in[i]);
+        if ( m_cropRects.empty() )
+        {
+            owners.emplace_back(i);
+            inputs.emplace_back(detInputs[i]);
+            continue;
+        }
+
+        const cv::Mat frame = fullFrame(in[i]);
+        for ( const auto& rect : m_cropRects )
+        {
+            owners.emplace_back(i);
+            inputs.emplace_back(frame(rect));
+        }
+    }
+    if ( inputs.empty() )
+    {
+        return;
+    }
+
+    auto& dOuts = s.dOuts;
+    m_yoloDetector->InferBatch(inputs, dOuts, m_settings->yoloMinConf(), m_acceptedObjectClasses);
+
+    const size_t step = m_cropRects.empty() ? 1 : m_cropRects.size();
+    for ( size_t k = 0; k < owners.size(); k += step )
+    {
+        const size_t i = owners[k];
+        if ( m_cropRects.empty() )
+        {
+            makeOutput(in[i], detInputs[i], dOuts[k], out[i]);
+            continue;
+        }
+
+        mergeCrops(&dOuts[k], step, s, s.merged);
+        makeOutput(in[i], detInputs[i], s.merged, out[i]);
+    }
+
+    /* Frames go back to the pool, only the capacity stays */
+    detInputs.clear();
+    inputs.clear();
+}
+
+void YOLOObjectDetector::preprocess(Detector::Job& job)
+{
+    if ( m_yoloDetector->empty() || !m_sampling->admit(job.in.timestamp, job.in.keyframe) )
+    {
+        job.skip = true;
+        return;
+    }
+
+    job.input = prepareInput(job.in);
+    if ( m_cropRects.empty() )
+    {
+        m_yoloDetector->Preprocess(job.input, job.blob);
+        return;
+    }
+
+    /* Crops are taken from the full frame, so small areas keep their resolution */
+    const cv::Mat frame = fullFrame(job.in);
+    auto& crops = m_preScratch.inputs;
+    crops.clear();
+    for ( const auto& rect : m_cropRects )
+    {
+        crops.emplace_back(frame(rect));
+    }
+    job.rois = m_cropRects;
+    m_yoloDetector->PreprocessBatch(crops, job.blob);
+    crops.clear();
+}
+
+void YOLOObjectDetector::infer(Detector::Job& job)
+{
+    m_yoloDetector->Forward(job.blob, job.raw);
+}
+
+void YOLOObjectDetector::postprocess(Detector::Job& job)
+{
+    Scratch& s = m_postScratch;
+    InferOuts& dOuts = s.merged;
+    dOuts.clear();
+    if ( job.rois.empty() )
+    {
+        m_yoloDetector->Postprocess(job.input.size(), job.raw, dOuts, m_settings->yoloMinConf(), m_acceptedObjectClasses);
+    }
+    else
+    {
+        s.cropSizes.clear();
+        for ( const auto& rect : job.rois )
+        {
+            s.cropSizes.emplace_back(rect.size());
+        }
+        m_yoloDetector->PostprocessBatch(s.cropSizes, job.raw, s.dOuts, m_settings->yoloMinConf(), m_acceptedObjectClasses);
+        mergeCrops(s.dOuts.data(), s.dOuts.size(), s, dOuts);
+    }
+    makeOutput(job.in, job.input, dOuts, job.out);
+}
+
+PlaneSpecs YOLOObjectDetector::requiredPlanes() const
+{
+    return { PlaneSpec{ PlaneSpec::Format::BGR, m_settings->detectorResolution() } };
+}
+
+const std::shared_ptr<YOLOObjectDetectorSettings>& YOLOObjectDetector::settings() const noexcept
+{
+    return m_settings;
+}
+
+cv::Mat YOLOObjectDetector::prepareInput(const Detector::InputData& in) const
+{
+    const cv::Mat* bgrPlane = ( in.frame ) 
+                            ? in.frame->planes.find(PlaneSpec::Format::BGR, m_settings->detectorResolution()) 
+                            : nullptr;
+    if ( bgrPlane )
+    {
+        return *bgrPlane;
+    }
+
+    cv::Mat frame(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
     if ( m_settings->detectorResolution() != m_imSize )
     {
         cv::resize(frame, frame, m_settings->detectorResolution(), 0.0, 0.0, cv::INTER_AREA);
     }
+    return frame;
+}
 
-    InferOuts dOuts;
-    m_yoloDetector->Infer(frame, dOuts, m_settings->yoloMinConf(), m_acceptedObjectClasses);
-
+void YOLOObjectDetector::makeOutput(const Detector::InputData& in, const cv::Mat& input, 
+                                    const InferOuts& dOuts, Detector::OutputData& out) const
+{
+    m_sampling->observe(in.timestamp, !dOuts.empty());
     if ( dOuts.empty() )
     {
         out.event = false;
@@ -128,40 +287,105 @@ void YOLOObjectDetector::process(const Detector::InputData& in, Detector::Output
     }
     std::copy(dOuts.begin(), dOuts.end(), back_inserter(out.eventInferOuts));
 
+    /* The event refers to the pooled frame, the boxes are drawn only if someone looks at it */
     if ( m_settings->displayDetailed() )
     {
-        out.eventDetailedFrame = frame.clone();
-        drawInferOuts(out.eventDetailedFrame, out.eventInferOuts, cv::Scalar::all(0), false, true);
+        if ( in.frame )
+        {
+            out.eventFrame = in.frame;
+        }
+        else
+        {
+            out.eventFrame = std::make_shared<Frame>();
+            out.eventFrame->image = input.clone();
+            out.eventFrame->timestamp = in.timestamp;
+        }
+    }
+}
+
+void YOLOObjectDetector::initCrops()
+{
+    if ( !m_settings->cropToAreas() )
+    {
+        return;
+    }
+
+    const cv::Size detSize = m_settings->detectorResolution();
+    const double sx = static_cast<double>(m_imSize.width) / detSize.width;
+    const double sy = static_cast<double>(m_imSize.height) / detSize.height;
+    const cv::Rect frameRect(cv::Point(0, 0), m_imSize);
+    for ( const auto& area : m_settings->areas() )
+    {
+        AreaMask areaMask(Areas{ area }, detSize);
+        const cv::Rect& r = areaMask.boundingRect();
+        const cv::Rect rect = cv::Rect(cvFloor(r.x * sx), cvFloor(r.y * sy), 
+                                       cvCeil(r.width * sx), cvCeil(r.height * sy)) & frameRect;
+        if ( rect.area() > 0 )
+        {
+            m_cropRects.emplace_back(rect);
+            m_cropMasks.emplace_back(std::move(areaMask));
+        }
+    }
+
+    /* A single crop of (almost) the whole frame buys nothing */
+    if ( m_cropRects.size() == 1 && m_cropRects[0].area() >= 0.9 * frameRect.area() )
+    {
+        m_cropRects.clear();
+        m_cropMasks.clear();
     }
 }
 
-const std::shared_ptr<YOLOObjectDetectorSettings>& YOLOObjectDetector::settings() const noexcept
+cv::Mat YOLOObjectDetector::fullFrame(const Detector::InputData& in) const
 {
-    return m_settings;
+    return cv::Mat(m_imSize, in.imType, const_cast<unsigned char *>(in.imData), in.imStep);
 }
 
-bool YOLOObjectDetector::filterByTimestamp(std::int64_t timestamp)
+void YOLOObjectDetector::mergeCrops(const InferOuts* cropOuts, size_t count, Scratch& scratch, InferOuts& out) const
 {
-    if ( m_settings->processFreqMs() <= 0 ) return false;
+    const cv::Size detSize = m_settings->detectorResolution();
+    const double sx = static_cast<double>(detSize.width) / m_imSize.width;
+    const double sy = static_cast<double>(detSize.height) / m_imSize.height;
 
-    if ( m_lastProcessedFrameMs == -1 )
-    {
-        m_lastProcessedFrameMs = timestamp;
-    }
-    else
+    out.clear();
+    auto& candidates = scratch.candidates;
+    auto& boxes = scratch.boxes;
+    auto& confidences = scratch.confidences;
+    candidates.clear();
+    boxes.clear();
+    confidences.clear();
+    /* Boxes of different classes are moved apart along x, so one NMS pass never suppresses across classes
+       (what cv::dnn::NMSBoxesBatched does, which older OpenCV lacks) */
+    const int classStride = 4 * std::max(detSize.width, detSize.height);
+    for ( size_t c = 0; c < count && c < m_cropRects.size(); ++c )
     {
-        if ( m_settings->processFreqMs() > 0 )
+        const cv::Point offset = m_cropRects[c].tl();
+        for ( const auto& dOut : cropOuts[c] )
         {
-            std::int64_t elapsed = timestamp - m_lastProcessedFrameMs;
-            if ( elapsed < m_settings->processFreqMs() )
+            const cv::Rect& loc = dOut.location;
+            const cv::Rect box(cvRound((loc.x + offset.x) * sx), cvRound((loc.y + offset.y) * sy),
+                               cvRound(loc.width * sx), cvRound(loc.height * sy));
+
+            /* The crop is a rectangle, the area does not have to be */
+            const cv::Point center(box.x + box.width / 2, box.y + box.height / 2);
+            if ( !m_cropMasks[c].contains(center) )
             {
-                return true;
+                continue;
             }
-            m_lastProcessedFrameMs = timestamp - (timestamp % m_settings->processFreqMs());
+
+            candidates.emplace_back(dOut);
+            candidates.back().location = box;
+            boxes.emplace_back(box.x + dOut.classId * classStride, box.y, box.width, box.height);
+            confidences.emplace_back(dOut.confidence);
         }
     }
 
-    return false;
+    /* Overlapping areas may report the same object twice */
+    auto& indices = scratch.indices;
+    cv::dnn::NMSBoxes(boxes, confidences, 0.0f, DEFAULT_NMS_THRESH, indices);
+    for ( int idx : indices )
+    {
+        out.emplace_back(candidates[idx]);
+    }
 }
 
 }
\ No newline at end of file
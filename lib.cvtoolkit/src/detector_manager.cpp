@@ -1,32 +1,87 @@
 #include <cvtoolkit/detector_manager.hpp>
+#include <cvtoolkit/thread_budget.hpp>
 
 namespace cvt
 {
 
-DetectorThreadManager::DetectorThreadManager(const std::shared_ptr<Detector>& detector, unsigned int threadID)
+namespace
+{
+
+/* Smoothing of the detector latency estimate */
+const double LatencyAlpha = 0.1;
+
+}
+
+DetectorThreadManager::DetectorThreadManager(const std::shared_ptr<Detector>& detector, unsigned int threadID, 
+                                             int queueCapacity, int inputPolicy)
     : m_detector(detector)
     , detectorThreadID(threadID)
+    , iDataQueue(queueCapacity, inputPolicy)
+    , oDataQueue(queueCapacity, SpscQueue<Detector::OutputData>::REJECT_NEWEST)
     , m_metrics(std::make_shared<cvt::MetricMaster>())
+    , m_spareOutputs(queueCapacity, SpscQueue<Detector::OutputData>::REJECT_NEWEST)
 {
 }
 
-DetectorThreadManager::DetectorThreadManager(DetectorThreadManager&& other)
-    : detectorThread(std::move(other.detectorThread))
-    , detectorThreadID(other.detectorThreadID)
-    , m_detector(std::move(other.m_detector))
-{}
-
-DetectorThreadManager& DetectorThreadManager::operator=(DetectorThreadManager&& other)
+DetectorThreadManager::DetectorThreadManager(const std::shared_ptr<Detector>& detector, 
+                                             const std::shared_ptr<DetectorScheduler>& scheduler,
+                                             unsigned int threadID, int queueCapacity, int inputPolicy)
+    : DetectorThreadManager(detector, threadID, queueCapacity, inputPolicy)
 {
-    detectorThread = std::move(other.detectorThread);
-    detectorThreadID = other.detectorThreadID;
-    m_detector = std::move(other.m_detector);
+    m_scheduler = scheduler;
+}
 
-    return *this;
+DetectorThreadManager::~DetectorThreadManager()
+{
+    if ( m_executor )
+    {
+        m_scheduler->remove(m_executor);
+    }
+    if ( m_runner )
+    {
+        m_runner->finish();
+    }
+    if ( m_sinkThread.joinable() )
+    {
+        m_stopDetectorThreads = true;
+        oDataQueue.finish();
+        m_sinkThread.join();
+    }
+    stopSnapshotThread();
 }
 
 void DetectorThreadManager::run()
 {
+    if ( !m_snapshotPath.empty() )
+    {
+        restoreState();
+        if ( m_snapshotPeriodMs > 0 )
+        {
+            m_snapshotThread = std::thread(&DetectorThreadManager::snapshotThreadLoop, this);
+        }
+    }
+
+    if ( m_pipelineDepth > 1 )
+    {
+        /* A freed stage slot brings the executor back for a held frame */
+        m_runner = std::make_unique<AsyncDetectorRunner>(m_detector, m_pipelineDepth, 
+                                                         [this](const Detector::Job& job) { complete(job); },
+                                                         [this]() { if ( m_executor ) m_executor->notify(); },
+                                                         "detector " + std::to_string(detectorThreadID));
+    }
+
+    if ( !m_callbacks.empty() )
+    {
+        m_sinkThread = std::thread(&DetectorThreadManager::sinkThreadLoop, this);
+    }
+
+    if ( m_scheduler )
+    {
+        attach();
+        std::cout << ">>> Detector " << detectorThreadID << " started on the shared scheduler" << std::endl;
+        return;
+    }
+
     auto detectorThreadFunc = std::bind(&DetectorThreadManager::detectorThreadLoop, this);
     detectorThread = std::thread(std::move(detectorThreadFunc));
 }
@@ -34,33 +89,157 @@ void DetectorThreadManager::run()
 void DetectorThreadManager::detectorThreadLoop()
 {
     std::cout << ">>> Detector thread " << detectorThreadID << " started" << std::endl;
+    pinToBudget(threadBudget().detectors.cores);
     while ( !m_stopDetectorThreads )
     {
-        auto iDataPtr = iDataQueue.pop1(1000);
-        if ( !iDataPtr || !iDataPtr->retval )
+        processOne(1000);
+    }
+    dropPending();
+
+    std::cout << ">>> Detector thread " << detectorThreadID << " finished" << std::endl;
+    printSummary();
+}
+
+bool DetectorThreadManager::submit(Detector::InputData&& iData)
+{
+    /* Let frames in at the rate the detector actually keeps up with */
+    if ( m_admission.adaptive )
+    {
+        const double latencyMs = m_latencyMs;
+        if ( m_lastAdmittedMs >= 0 && iData.captureTime - m_lastAdmittedMs < latencyMs )
         {
-            continue;
+            ++m_rejectedFrames;
+            return false;
         }
+        m_lastAdmittedMs = iData.captureTime;
+    }
 
-        auto m = m_metrics->measure();
+    iDataQueue.push(std::move(iData));
+    if ( m_executor )
+    {
+        m_executor->notify();
+    }
+    return true;
+}
 
-        Detector::InputData iData = *iDataPtr;
-        Detector::OutputData oData;
-        m_detector->process(std::move(iData), oData);
+void DetectorThreadManager::setAdmission(const AdmissionSettings& admission)
+{
+    m_admission = admission;
+}
 
-        if ( oData.event )
-        {
-            oDataQueue.push(std::move(oData));
-        }
+void DetectorThreadManager::setPipelineDepth(int depth)
+{
+    m_pipelineDepth = std::max(1, depth);
+}
+
+void DetectorThreadManager::setBatchSize(int size)
+{
+    m_batchSize = std::max(1, size);
+}
+
+void DetectorThreadManager::setSnapshot(const std::string& path, std::int64_t periodMs)
+{
+    m_snapshotPath = path;
+    m_snapshotPeriodMs = std::max<std::int64_t>(0, periodMs);
+}
+
+std::int64_t DetectorThreadManager::staleFrames() const noexcept
+{
+    return m_staleFrames;
+}
+
+std::int64_t DetectorThreadManager::rejectedFrames() const noexcept
+{
+    return m_rejectedFrames;
+}
+
+std::int64_t DetectorThreadManager::abandonedFrames() const noexcept
+{
+    return m_abandonedFrames;
+}
+
+double DetectorThreadManager::latency() const noexcept
+{
+    return m_latencyMs;
+}
+
+std::int64_t DetectorThreadManager::lastProcessedCaptureTime() const noexcept
+{
+    return m_lastProcessedCaptureTime;
+}
+
+void DetectorThreadManager::onEvent(EventCallback callback)
+{
+    m_callbacks.emplace_back(std::move(callback));
+}
+
+int DetectorThreadManager::drain(std::vector<Detector::OutputData>& events)
+{
+    if ( !m_callbacks.empty() )
+    {
+        return 0;
     }
 
-    std::cout << ">>> Detector thread " << detectorThreadID << " finished" << std::endl;
-    std::cout << ">>> Detector thread " << detectorThreadID << " metrics: " << m_metrics->summary() << std::endl;
+    int count = 0;
+    Detector::OutputData oData;
+    while ( oDataQueue.tryPop(oData) )
+    {
+        events.emplace_back(std::move(oData));
+        ++count;
+    }
+    return count;
+}
+
+void DetectorThreadManager::recycle(std::vector<Detector::OutputData>& events)
+{
+    for ( auto& event : events )
+    {
+        event.reset();
+        m_spareOutputs.push(std::move(event));
+    }
+    events.clear();
 }
 
 void DetectorThreadManager::finish()
 {
     m_stopDetectorThreads = true;
+    iDataQueue.finish();
+}
+
+void DetectorThreadManager::join()
+{
+    if ( detectorThread.joinable() )
+    {
+        detectorThread.join();
+    }
+    else if ( m_executor )
+    {
+        m_scheduler->remove(m_executor);
+        dropPending();
+        std::cout << ">>> Detector " << detectorThreadID << " finished" << std::endl;
+        printSummary();
+    }
+
+    /* Frames already in the stages still produce events */
+    if ( m_runner )
+    {
+        m_runner->finish();
+    }
+    m_executor.reset();
+
+    /* The detector is over, so the sink has got everything it will ever get */
+    if ( m_sinkThread.joinable() )
+    {
+        oDataQueue.finish();
+        m_sinkThread.join();
+    }
+
+    /* The final state is written here, after any periodic write in progress */
+    stopSnapshotThread();
+    if ( !m_snapshotPath.empty() )
+    {
+        saveState();
+    }
 }
 
 bool DetectorThreadManager::isRunning() const noexcept
@@ -73,4 +252,373 @@ const std::shared_ptr<Detector> DetectorThreadManager::detector() const noexcept
     return m_detector;
 }
 
-}
\ No newline at end of file
+double DetectorThreadManager::cpuTime() const noexcept
+{
+    return m_cpuTimeUs / 1000.0 + ( m_runner ? m_runner->cpuTime() : 0.0 );
+}
+
+void DetectorThreadManager::sinkThreadLoop()
+{
+    /* Callbacks are user code, which belongs to no pool */
+    pinToBudget();
+    /* Runs until join() finishes the queue, which it does only after the stages have been flushed,
+       so events of the frames in flight at stop are delivered too */
+    Detector::OutputData oData;
+    while ( true )
+    {
+        if ( !oDataQueue.pop1(oData, 1000) )
+        {
+            if ( oDataQueue.finished() && oDataQueue.empty() )
+            {
+                break;
+            }
+            continue;
+        }
+
+        if ( oData.event )
+        {
+            for ( const auto& callback : m_callbacks )
+            {
+                callback(oData);
+            }
+        }
+        oData.reset();
+        m_spareOutputs.push(std::move(oData));
+    }
+}
+
+void DetectorThreadManager::attach()
+{
+    /* Runs once per submitted frame, never concurrently with itself */
+    m_executor = m_scheduler->add("detector " + std::to_string(detectorThreadID), [this]() {
+        if ( !m_stopDetectorThreads )
+        {
+            processOne(0);
+        }
+    });
+}
+
+bool DetectorThreadManager::processOne(std::int64_t waitForMs)
+{
+    /* A shared worker must not wait for the stages */
+    if ( m_runner && m_scheduler )
+    {
+        return feedRunner();
+    }
+
+    Detector::InputData iData;
+    if ( !iDataQueue.pop1(iData, waitForMs) || !iData.retval )
+    {
+        return false;
+    }
+
+    const std::int64_t startMs = steadyClockMs();
+    if ( m_admission.maxFrameAgeMs > 0 && startMs - iData.captureTime > m_admission.maxFrameAgeMs )
+    {
+        ++m_staleFrames;
+        return false;
+    }
+
+    if ( m_runner )
+    {
+        /* Blocks while the stages are full, results come out in complete() */
+        m_runner->submit(std::move(iData));
+        return true;
+    }
+
+    if ( m_batchSize > 1 )
+    {
+        return processBatch(std::move(iData));
+    }
+
+    const std::int64_t cpuStart = threadCpuTimeUs();
+    {
+        auto m = m_metrics->measure();
+
+        Detector::OutputData& oData = spareOutput();
+        m_detector->process(iData, oData);
+        publish(oData);
+    }
+    m_cpuTimeUs += threadCpuTimeUs() - cpuStart;
+    m_lastProcessedCaptureTime = iData.captureTime;
+    snapshotIfDue();
+
+    const double elapsedMs = static_cast<double>(steadyClockMs() - startMs);
+    const double latencyMs = m_latencyMs;
+    m_latencyMs = ( latencyMs > 0.0 ) ? (1.0 - LatencyAlpha) * latencyMs + LatencyAlpha * elapsedMs : elapsedMs;
+    return true;
+}
+
+bool DetectorThreadManager::processBatch(Detector::InputData&& first)
+{
+    const std::int64_t startMs = steadyClockMs();
+
+    /* Take whatever else is already queued, without waiting for a full batch */
+    m_batchIn.clear();
+    m_batchIn.emplace_back(std::move(first));
+    Detector::InputData iData;
+    while ( static_cast<int>(m_batchIn.size()) < m_batchSize && iDataQueue.tryPop(iData) )
+    {
+        if ( !iData.retval )
+        {
+            continue;
+        }
+        if ( m_admission.maxFrameAgeMs > 0 && startMs - iData.captureTime > m_admission.maxFrameAgeMs )
+        {
+            ++m_staleFrames;
+            continue;
+        }
+        m_batchIn.emplace_back(std::move(iData));
+    }
+
+    const std::int64_t cpuStart = threadCpuTimeUs();
+    {
+        auto m = m_metrics->measure();
+
+        m_detector->processBatch(m_batchIn, m_batchOut);
+
+        for ( auto& oData : m_batchOut )
+        {
+            /* Published outputs leave empty shells behind, fill them with recycled ones */
+            if ( publish(oData) )
+            {
+                m_spareOutputs.tryPop(oData);
+            }
+        }
+    }
+    m_cpuTimeUs += threadCpuTimeUs() - cpuStart;
+    m_lastProcessedCaptureTime = m_batchIn.back().captureTime;
+    snapshotIfDue();
+
+    /* Admission cares about how often a frame can be taken, so spread the batch time over its frames */
+    const double elapsedMs = static_cast<double>(steadyClockMs() - startMs) / m_batchIn.size();
+    const double latencyMs = m_latencyMs;
+    m_latencyMs = ( latencyMs > 0.0 ) ? (1.0 - LatencyAlpha) * latencyMs + LatencyAlpha * elapsedMs : elapsedMs;
+
+    /* Release the frames right away, but keep the output buffers */
+    m_batchIn.clear();
+    for ( auto& oData : m_batchOut )
+    {
+        oData.reset();
+    }
+    return true;
+}
+
+bool DetectorThreadManager::feedRunner()
+{
+    /* The held frame goes first, then queued ones while there is room. A frame which does not fit is held
+       until the runner releases a slot and notifies the executor */
+    bool submitted = false;
+    while ( true )
+    {
+        if ( !m_inputHeld )
+        {
+            if ( !iDataQueue.tryPop(m_heldInput) )
+            {
+                break;
+            }
+            if ( !m_heldInput.retval )
+            {
+                continue;
+            }
+            if ( m_admission.maxFrameAgeMs > 0 && steadyClockMs() - m_heldInput.captureTime > m_admission.maxFrameAgeMs )
+            {
+                ++m_staleFrames;
+                continue;
+            }
+            m_inputHeld = true;
+        }
+
+        if ( !m_runner->trySubmit(m_heldInput) )
+        {
+            break;
+        }
+        m_inputHeld = false;
+        submitted = true;
+    }
+    return submitted;
+}
+
+void DetectorThreadManager::dropPending()
+{
+    /* Nobody is going to process them anymore, so at least they are counted */
+    std::int64_t left = 0;
+    if ( m_inputHeld )
+    {
+        m_heldInput = Detector::InputData();
+        m_inputHeld = false;
+        ++left;
+    }
+    Detector::InputData iData;
+    while ( iDataQueue.tryPop(iData) )
+    {
+        if ( iData.retval )
+        {
+            ++left;
+        }
+    }
+    m_abandonedFrames += left;
+}
+
+void DetectorThreadManager::complete(const Detector::Job& job)
+{
+    m_lastProcessedCaptureTime = job.in.captureTime;
+
+    /* The detector takes frames as often as its slowest stage lets it */
+    double slowestMs = 0.0;
+    for ( int stage = 0; stage < 3; ++stage )
+    {
+        slowestMs = std::max(slowestMs, m_runner->stageTime(stage));
+    }
+    m_latencyMs = slowestMs;
+
+    if ( job.out.event )
+    {
+        /* Copying into a recycled output reuses its buffers */
+        Detector::OutputData& oData = spareOutput();
+        oData = job.out;
+        publish(oData);
+    }
+}
+
+Detector::OutputData& DetectorThreadManager::spareOutput()
+{
+    if ( m_outputTaken )
+    {
+        m_spareOutputs.tryPop(m_output);
+        m_outputTaken = false;
+    }
+    m_output.reset();
+    return m_output;
+}
+
+bool DetectorThreadManager::publish(Detector::OutputData& oData)
+{
+    if ( !oData.event )
+    {
+        return false;
+    }
+
+    /* A rejected output stays intact and is reused */
+    const bool published = oDataQueue.push(std::move(oData));
+    if ( published && &oData == &m_output )
+    {
+        m_outputTaken = true;
+    }
+    return published;
+}
+
+bool DetectorThreadManager::saveState()
+{
+    SnapshotWriter snapshot;
+    if ( !m_detector->saveState(snapshot) )
+    {
+        return false;
+    }
+    if ( !saveSnapshot(m_snapshotPath, snapshot) )
+    {
+        std::cerr << ">>> Detector " << detectorThreadID << " could not save its state to " << m_snapshotPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool DetectorThreadManager::restoreState()
+{
+    SnapshotReader snapshot;
+    if ( !loadSnapshot(m_snapshotPath, snapshot) )
+    {
+        return false; // first run or a damaged file, the detector learns from scratch
+    }
+    if ( !m_detector->loadState(snapshot) )
+    {
+        std::cerr << ">>> Detector " << detectorThreadID << " could not restore its state from " << m_snapshotPath << std::endl;
+        return false;
+    }
+    std::cout << ">>> Detector " << detectorThreadID << " restored its state from " << m_snapshotPath << std::endl;
+    return true;
+}
+
+void DetectorThreadManager::snapshotIfDue()
+{
+    if ( m_snapshotPath.empty() || m_snapshotPeriodMs <= 0 )
+    {
+        return;
+    }
+
+    const std::int64_t nowMs = steadyClockMs();
+    if ( m_lastSnapshotMs < 0 )
+    {
+        m_lastSnapshotMs = nowMs;
+        return;
+    }
+    if ( nowMs - m_lastSnapshotMs >= m_snapshotPeriodMs )
+    {
+        /* Only the copy is made here, the writer thread takes it to the disk */
+        m_snapshotCopy.clear();
+        if ( m_detector->saveState(m_snapshotCopy) )
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_snapshotMutex);
+                std::swap(m_snapshotCopy, m_snapshotPending); // an unwritten older copy is superseded
+                m_snapshotReady = true;
+            }
+            m_snapshotCondition.notify_one();
+        }
+        m_lastSnapshotMs = nowMs;
+    }
+}
+
+void DetectorThreadManager::printSummary() const
+{
+    std::cout << ">>> Detector thread " << detectorThreadID << " metrics: " << m_metrics->summary() << std::endl;
+    std::cout << ">>> Detector thread " << detectorThreadID << " CPU time: " << cpuTime() << " ms" << std::endl;
+    std::cout << ">>> Detector thread " << detectorThreadID << " dropped frames: " << iDataQueue.dropped() 
+              << " (overflow), " << staleFrames() << " (stale), " << rejectedFrames() << " (not admitted), "
+              << abandonedFrames() << " (left at stop)" << std::endl;
+    if ( m_runner )
+    {
+        std::cout << ">>> Detector thread " << detectorThreadID << " stages: " << m_runner->summary() << std::endl;
+    }
+}
+
+void DetectorThreadManager::snapshotThreadLoop()
+{
+    /* File I/O belongs to no pool */
+    pinToBudget();
+    SnapshotWriter snapshot;
+    while ( true )
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_snapshotMutex);
+            m_snapshotCondition.wait(lock, [this]{ return m_snapshotReady || m_stopSnapshots; });
+            if ( !m_snapshotReady )
+            {
+                break;
+            }
+            std::swap(snapshot, m_snapshotPending);
+            m_snapshotReady = false;
+        }
+
+        if ( !saveSnapshot(m_snapshotPath, snapshot) )
+        {
+            std::cerr << ">>> Detector " << detectorThreadID << " could not save its state to " << m_snapshotPath << std::endl;
+        }
+    }
+}
+
+void DetectorThreadManager::stopSnapshotThread()
+{
+    if ( !m_snapshotThread.joinable() )
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_snapshotMutex);
+        m_stopSnapshots = true;
+    }
+    m_snapshotCondition.notify_one();
+    m_snapshotThread.join();
+}
+
+}
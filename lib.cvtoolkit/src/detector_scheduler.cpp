@@ -0,0 +1,286 @@
+#include "cvtoolkit/detector_scheduler.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <chrono>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+namespace cvt
+{
+
+namespace
+{
+
+/* Index of the worker the current thread is (-1 for foreign threads) */
+thread_local int currentWorkerID = -1;
+
+/* Executor runs done in one go before it is put back, so that busy detectors do not starve the others */
+const int MaxRunsInRow = 4;
+
+}
+
+std::int64_t threadCpuTimeUs() noexcept
+{
+#ifdef _WIN32
+    FILETIME creationTime, exitTime, kernelTime, userTime;
+    if ( !GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime) )
+    {
+        return 0;
+    }
+    const auto toUs = [](const FILETIME& t) { 
+        return ((static_cast<std::int64_t>(t.dwHighDateTime) << 32) | t.dwLowDateTime) / 10; 
+    };
+    return toUs(kernelTime) + toUs(userTime);
+#else
+    timespec ts;
+    if ( clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0 )
+    {
+        return 0;
+    }
+    return static_cast<std::int64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+
+DetectorScheduler::Executor::Executor(DetectorScheduler* scheduler, const std::string& name, std::function<void()> work)
+    : m_scheduler(scheduler)
+    , m_name(name)
+    , m_work(std::move(work))
+{
+}
+
+void DetectorScheduler::Executor::notify()
+{
+    if ( m_removed )
+    {
+        return;
+    }
+
+    ++m_pending;
+    bool expected = false;
+    if ( m_scheduled.compare_exchange_strong(expected, true) )
+    {
+        m_scheduler->schedule(shared_from_this());
+    }
+}
+
+const std::string& DetectorScheduler::Executor::name() const noexcept
+{
+    return m_name;
+}
+
+std::int64_t DetectorScheduler::Executor::runs() const noexcept
+{
+    return m_runs;
+}
+
+double DetectorScheduler::Executor::cpuTime() const noexcept
+{
+    return m_cpuTimeUs / 1000.0;
+}
+
+
+DetectorScheduler::DetectorScheduler(int threads)
+{
+    if ( threads <= 0 )
+    {
+        threads = threadBudget().detectors.threads;
+    }
+    if ( threads <= 0 )
+    {
+        threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+
+    for ( int i = 0; i < threads; ++i )
+    {
+        m_queues.emplace_back(std::make_unique<WorkerQueue>());
+    }
+    for ( int i = 0; i < threads; ++i )
+    {
+        m_workers.emplace_back(&DetectorScheduler::workerLoop, this, i);
+    }
+}
+
+DetectorScheduler::~DetectorScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_wakeup.notify_all();
+    for ( auto& worker : m_workers )
+    {
+        if ( worker.joinable() )
+        {
+            worker.join();
+        }
+    }
+}
+
+DetectorScheduler::ExecutorPtr DetectorScheduler::add(const std::string& name, std::function<void()> work)
+{
+    ExecutorPtr executor(new Executor(this, name, std::move(work)));
+    std::lock_guard<std::mutex> lock(m_executorsMutex);
+    m_executors.emplace_back(executor);
+    return executor;
+}
+
+void DetectorScheduler::remove(const ExecutorPtr& executor)
+{
+    if ( !executor )
+    {
+        return;
+    }
+
+    executor->m_removed = true;
+    {
+        std::lock_guard<std::mutex> lock(m_executorsMutex);
+        m_executors.erase(std::remove(m_executors.begin(), m_executors.end(), executor), m_executors.end());
+    }
+
+    /* The executor may still sit in a deque, workers skip it there */
+    while ( executor->m_running )
+    {
+        std::this_thread::yield();
+    }
+}
+
+int DetectorScheduler::threads() const noexcept
+{
+    return static_cast<int>(m_workers.size());
+}
+
+std::int64_t DetectorScheduler::steals() const noexcept
+{
+    return m_steals;
+}
+
+std::string DetectorScheduler::summary() const
+{
+    std::ostringstream oss;
+    oss << "[DetectorScheduler] " << threads() << " workers, " << steals() << " steals";
+    std::lock_guard<std::mutex> lock(m_executorsMutex);
+    for ( const auto& executor : m_executors )
+    {
+        oss << std::endl << "\t- " << executor->name() << ": " << executor->runs() << " runs, " 
+            << executor->cpuTime() << " ms CPU";
+    }
+    return oss.str();
+}
+
+void DetectorScheduler::schedule(const ExecutorPtr& executor)
+{
+    /* Workers keep rescheduled executors to themselves, others spread them round-robin */
+    const int queueID = ( currentWorkerID >= 0 ) 
+        ? currentWorkerID 
+        : static_cast<int>(m_nextQueue++ % m_queues.size());
+    {
+        std::lock_guard<std::mutex> lock(m_queues[queueID]->mutex);
+        m_queues[queueID]->executors.emplace_back(executor);
+    }
+    ++m_queued;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wakeup.notify_one();
+}
+
+DetectorScheduler::ExecutorPtr DetectorScheduler::take(int workerID)
+{
+    /* Own deque from the back (hot caches), others' from the front */
+    {
+        WorkerQueue& own = *m_queues[workerID];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if ( !own.executors.empty() )
+        {
+            ExecutorPtr executor = std::move(own.executors.back());
+            own.executors.pop_back();
+            --m_queued;
+            return executor;
+        }
+    }
+
+    const int nQueues = static_cast<int>(m_queues.size());
+    for ( int i = 1; i < nQueues; ++i )
+    {
+        WorkerQueue& victim = *m_queues[(workerID + i) % nQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if ( !victim.executors.empty() )
+        {
+            ExecutorPtr executor = std::move(victim.executors.front());
+            victim.executors.pop_front();
+            --m_queued;
+            ++m_steals;
+            return executor;
+        }
+    }
+    return nullptr;
+}
+
+void DetectorScheduler::run(const ExecutorPtr& executor, int workerID)
+{
+    /* Pairs with remove(): either it sees us running or we see the executor removed */
+    executor->m_running = true;
+    if ( executor->m_removed )
+    {
+        executor->m_running = false;
+        return;
+    }
+
+    const std::int64_t cpuStart = threadCpuTimeUs();
+    for ( int i = 0; i < MaxRunsInRow && executor->m_pending > 0 && !executor->m_removed; ++i )
+    {
+        --executor->m_pending;
+        executor->m_work();
+        ++executor->m_runs;
+    }
+    executor->m_cpuTimeUs += threadCpuTimeUs() - cpuStart;
+    executor->m_running = false;
+
+    if ( executor->m_removed )
+    {
+        return;
+    }
+
+    /* Put it back if there is more to do, mind notify() racing with us */
+    if ( executor->m_pending > 0 )
+    {
+        schedule(executor);
+        return;
+    }
+    executor->m_scheduled = false;
+    bool expected = false;
+    if ( executor->m_pending > 0 && executor->m_scheduled.compare_exchange_strong(expected, true) )
+    {
+        schedule(executor);
+    }
+}
+
+void DetectorScheduler::workerLoop(int workerID)
+{
+    currentWorkerID = workerID;
+    pinToBudget(threadBudget().detectors.cores);
+    while ( true )
+    {
+        ExecutorPtr executor = take(workerID);
+        if ( executor )
+        {
+            run(executor, workerID);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_wakeup.wait(lock, [this]{ return m_stop || m_queued > 0; });
+        if ( m_stop )
+        {
+            break;
+        }
+    }
+}
+
+}
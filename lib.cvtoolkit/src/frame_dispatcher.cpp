@@ -0,0 +1,121 @@
+#include "cvtoolkit/frame_dispatcher.hpp"
+
+#include <sstream>
+#include <algorithm>
+
+namespace cvt
+{
+
+int FrameDispatcher::subscribe(DetectorThreadManager& manager)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Subscriber subscriber;
+    subscriber.id = m_nextID++;
+    subscriber.manager = &manager;
+    m_subscribers.emplace_back(subscriber);
+    return subscriber.id;
+}
+
+void FrameDispatcher::unsubscribe(int id)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_subscribers.erase(std::remove_if(m_subscribers.begin(), m_subscribers.end(), 
+                                       [id](const Subscriber& s) { return s.id == id; }), 
+                        m_subscribers.end());
+}
+
+int FrameDispatcher::publish(const FrameHandle& frame)
+{
+    if ( !frame || frame->image.empty() )
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int accepted = 0;
+    for ( auto& subscriber : m_subscribers )
+    {
+        /* Every subscriber holds a reference to the same buffer */
+        Detector::InputData iData(frame);
+        ++subscriber.published;
+        if ( subscriber.manager->submit(std::move(iData)) )
+        {
+            ++subscriber.admitted;
+            ++accepted;
+        }
+    }
+    m_lastCaptureTime = frame->captureTime;
+    return accepted;
+}
+
+int FrameDispatcher::subscribers() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return static_cast<int>(m_subscribers.size());
+}
+
+FrameDispatcher::SubscriberStats FrameDispatcher::stats(int id) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for ( const auto& subscriber : m_subscribers )
+    {
+        if ( subscriber.id == id )
+        {
+            return makeStats(subscriber);
+        }
+    }
+    return SubscriberStats();
+}
+
+int FrameDispatcher::slowestSubscriber() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    int slowestID = -1;
+    std::int64_t maxLag = -1;
+    for ( const auto& subscriber : m_subscribers )
+    {
+        const std::int64_t lag = makeStats(subscriber).lagMs;
+        if ( lag > maxLag )
+        {
+            maxLag = lag;
+            slowestID = subscriber.id;
+        }
+    }
+    return slowestID;
+}
+
+std::string FrameDispatcher::summary() const
+{
+    std::ostringstream oss;
+    oss << "[FrameDispatcher]";
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for ( const auto& subscriber : m_subscribers )
+    {
+        const SubscriberStats stats = makeStats(subscriber);
+        oss << std::endl << "\t- detector " << subscriber.manager->detectorThreadID 
+            << ": admitted " << stats.admitted << "/" << stats.published 
+            << ", queued " << stats.queued << ", lag " << stats.lagMs << " ms";
+    }
+    return oss.str();
+}
+
+FrameDispatcher::SubscriberStats FrameDispatcher::makeStats(const Subscriber& subscriber) const
+{
+    SubscriberStats stats;
+    stats.published = subscriber.published;
+    stats.admitted = subscriber.admitted;
+    stats.queued = subscriber.manager->iDataQueue.size();
+
+    const std::int64_t lastProcessed = subscriber.manager->lastProcessedCaptureTime();
+    if ( m_lastCaptureTime >= 0 && lastProcessed >= 0 )
+    {
+        stats.lagMs = std::max<std::int64_t>(0, m_lastCaptureTime - lastProcessed);
+    }
+    else if ( m_lastCaptureTime >= 0 && subscriber.admitted > 0 )
+    {
+        stats.lagMs = steadyClockMs() - m_lastCaptureTime;
+    }
+    return stats;
+}
+
+}
@@ -0,0 +1,137 @@
+#include "cvtoolkit/frame_pool.hpp"
+
+#include <sstream>
+#include <chrono>
+
+namespace cvt
+{
+
+FramePool::FramePool(cv::Size size, int type, int capacity)
+    : m_size(size)
+    , m_type(type)
+    , m_capacity(std::max(capacity, 1))
+{
+    m_free.reserve(m_capacity);
+}
+
+FrameHandle FramePool::acquire(std::int64_t waitForMs)
+{
+    using namespace std::chrono_literals;
+
+    std::unique_ptr<Frame> frame;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        if ( m_free.empty() && m_allocated >= m_capacity )
+        {
+            m_condition.wait_for(lock, waitForMs * 1ms, [&]{ return !m_free.empty(); });
+            if ( m_free.empty() )
+            {
+                return nullptr;
+            }
+        }
+
+        if ( !m_free.empty() )
+        {
+            frame = std::move(m_free.back());
+            m_free.pop_back();
+        }
+        else
+        {
+            frame = std::make_unique<Frame>();
+            frame->image.create(m_size, m_type);
+            ++m_allocated;
+        }
+
+        ++m_inUse;
+        m_highWater = std::max(m_highWater, m_inUse);
+    }
+
+    /* The deleter must not keep the pool alive, otherwise outstanding frames would leak it */
+    std::weak_ptr<FramePool> weakPool = weak_from_this();
+    return FrameHandle(frame.release(), [weakPool](Frame* f)
+    {
+        if ( auto pool = weakPool.lock() )
+        {
+            pool->release(f);
+        }
+        else
+        {
+            delete f;
+        }
+    });
+}
+
+void FramePool::release(Frame* frame)
+{
+    frame->timestamp = -1;
+    frame->captureTime = -1;
+    frame->frameNum = -1;
+    frame->keyframe = false;
+    frame->planes.clear();
+
+    /* A cv::Mat still sharing the buffer (e.g. kept by a consumer past the handle) would see the next frame
+       written into it, so the buffer is left to its holder and the frame gets a fresh one */
+    const bool shared = frame->image.u && frame->image.u->refcount > 1;
+    if ( shared || !frame->image.u || frame->image.size() != m_size || frame->image.type() != m_type )
+    {
+        frame->image = cv::Mat(m_size, m_type);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_free.emplace_back(frame);
+        --m_inUse;
+    }
+    m_condition.notify_one();
+}
+
+cv::Size FramePool::size() const noexcept
+{
+    return m_size;
+}
+
+int FramePool::type() const noexcept
+{
+    return m_type;
+}
+
+int FramePool::capacity() const noexcept
+{
+    return m_capacity;
+}
+
+int FramePool::inUse() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inUse;
+}
+
+std::size_t FramePool::frameBytes() const noexcept
+{
+    return static_cast<std::size_t>(m_size.area()) * CV_ELEM_SIZE(m_type);
+}
+
+int FramePool::highWaterFrames() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_highWater;
+}
+
+std::size_t FramePool::highWaterMark() const
+{
+    return highWaterFrames() * frameBytes();
+}
+
+std::string FramePool::summary() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::stringstream ss;
+    ss << "Capacity: " << m_capacity
+        << ", allocated: " << m_allocated
+        << ", in use: " << m_inUse
+        << ", high-water mark: " << m_highWater << " frames (" << (m_highWater * frameBytes()) / 1024 << " KB)";
+
+    return ss.str();
+}
+
+}
@@ -0,0 +1,288 @@
+#include "cvtoolkit/frame_store.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace cvt
+{
+
+namespace
+{
+
+const char StoreMagic[8] = { 'C', 'V', 'T', 'F', 'R', 'S', '0', '1' };
+const std::uint64_t FrameAlignment = 64;
+
+struct StoreHeader
+{
+    char magic[8];
+    double fps;
+};
+
+}
+
+FrameStoreWriter::FrameStoreWriter(const std::string& path, double fps)
+{
+    open(path, fps);
+}
+
+FrameStoreWriter::~FrameStoreWriter()
+{
+    release();
+}
+
+bool FrameStoreWriter::open(const std::string& path, double fps)
+{
+    release();
+
+    m_data.open(path, std::ios::binary | std::ios::trunc);
+    m_index.open(FrameStoreReader::indexPath(path), std::ios::binary | std::ios::trunc);
+    if ( !m_data.good() || !m_index.good() )
+    {
+        std::cerr << ">>> [FrameStoreWriter] Could not open " << path << std::endl;
+        release();
+        return false;
+    }
+
+    StoreHeader header;
+    std::memcpy(header.magic, StoreMagic, sizeof(StoreMagic));
+    header.fps = fps;
+    m_index.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return m_index.good();
+}
+
+bool FrameStoreWriter::write(const cv::Mat& frame, std::int64_t timestamp)
+{
+    if ( !isOpened() || frame.empty() )
+    {
+        return false;
+    }
+
+    const cv::Mat continuous = frame.isContinuous() ? frame : frame.clone();
+
+    FrameStoreEntry entry;
+    entry.offset = m_offset;
+    entry.timestamp = timestamp;
+    entry.rows = continuous.rows;
+    entry.cols = continuous.cols;
+    entry.type = continuous.type();
+    entry.bytes = static_cast<std::uint32_t>(continuous.total() * continuous.elemSize());
+
+    /* Keep every frame aligned, so that mapped frames are as good as allocated ones for SIMD */
+    const std::uint64_t padding = (FrameAlignment - entry.bytes % FrameAlignment) % FrameAlignment;
+    static const char zeros[FrameAlignment] = {};
+    m_data.write(reinterpret_cast<const char*>(continuous.data), entry.bytes);
+    m_data.write(zeros, padding);
+    m_offset += entry.bytes + padding;
+
+    /* The index entry goes after the data, so that an interrupted recording stays readable */
+    m_index.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    ++m_frames;
+    return m_data.good() && m_index.good();
+}
+
+void FrameStoreWriter::release()
+{
+    if ( m_data.is_open() )
+    {
+        m_data.close();
+    }
+    if ( m_index.is_open() )
+    {
+        m_index.close();
+    }
+    m_offset = 0;
+    m_frames = 0;
+}
+
+bool FrameStoreWriter::isOpened() const noexcept
+{
+    return m_data.is_open() && m_index.is_open();
+}
+
+int FrameStoreWriter::frames() const noexcept
+{
+    return m_frames;
+}
+
+
+FrameStoreReader::FrameStoreReader(const std::string& path)
+{
+    open(path);
+}
+
+FrameStoreReader::~FrameStoreReader()
+{
+    release();
+}
+
+bool FrameStoreReader::open(const std::string& path)
+{
+    release();
+
+    /* Read the index */
+    std::ifstream ifs(indexPath(path), std::ios::binary);
+    StoreHeader header;
+    ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if ( !ifs || std::memcmp(header.magic, StoreMagic, sizeof(StoreMagic)) != 0 )
+    {
+        std::cerr << ">>> [FrameStoreReader] Invalid index " << indexPath(path) << std::endl;
+        return false;
+    }
+    m_fps = header.fps;
+
+    FrameStoreEntry entry;
+    while ( ifs.read(reinterpret_cast<char*>(&entry), sizeof(entry)) )
+    {
+        m_entries.emplace_back(entry);
+    }
+
+    /* Map the data */
+    std::error_code ec;
+    const std::size_t dataSize = static_cast<std::size_t>(std::filesystem::file_size(path, ec));
+    if ( ec || dataSize == 0 )
+    {
+        std::cerr << ">>> [FrameStoreReader] Could not open " << path << std::endl;
+        release();
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, 
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if ( file == INVALID_HANDLE_VALUE )
+    {
+        std::cerr << ">>> [FrameStoreReader] Could not open " << path << std::endl;
+        release();
+        return false;
+    }
+    m_file = file;
+    m_mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+    void* data = m_mapping ? MapViewOfFile(m_mapping, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+    if ( !data )
+    {
+        std::cerr << ">>> [FrameStoreReader] Could not map " << path << std::endl;
+        release();
+        return false;
+    }
+#else
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if ( fd < 0 )
+    {
+        std::cerr << ">>> [FrameStoreReader] Could not open " << path << std::endl;
+        release();
+        return false;
+    }
+    void* data = ::mmap(nullptr, dataSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if ( data == MAP_FAILED )
+    {
+        std::cerr << ">>> [FrameStoreReader] Could not map " << path << std::endl;
+        release();
+        return false;
+    }
+    ::madvise(data, dataSize, MADV_SEQUENTIAL);
+#endif
+    m_data = static_cast<uchar*>(data);
+    m_dataSize = dataSize;
+
+    /* Drop entries whose geometry does not match their size, frame() would read past them */
+    const size_t indexed = m_entries.size();
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(), [](const FrameStoreEntry& entry)
+    {
+        return entry.rows <= 0 || entry.cols <= 0 || entry.type != CV_MAT_TYPE(entry.type)
+            || static_cast<std::uint64_t>(entry.rows) * static_cast<std::uint64_t>(entry.cols) * CV_ELEM_SIZE(entry.type) != entry.bytes;
+    }), m_entries.end());
+    if ( m_entries.size() < indexed )
+    {
+        std::cerr << ">>> [FrameStoreReader] " << indexed - m_entries.size() << " malformed entries dropped from "
+                  << indexPath(path) << std::endl;
+    }
+
+    /* Drop the tail of an interrupted recording */
+    while ( !m_entries.empty() && m_entries.back().offset + m_entries.back().bytes > m_dataSize )
+    {
+        m_entries.pop_back();
+    }
+    return true;
+}
+
+void FrameStoreReader::release()
+{
+#ifdef _WIN32
+    if ( m_data )
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if ( m_mapping )
+    {
+        CloseHandle(m_mapping);
+        m_mapping = nullptr;
+    }
+    if ( m_file )
+    {
+        CloseHandle(m_file);
+        m_file = nullptr;
+    }
+#else
+    if ( m_data )
+    {
+        ::munmap(m_data, m_dataSize);
+    }
+#endif
+    m_data = nullptr;
+    m_dataSize = 0;
+    m_entries.clear();
+    m_fps = 0.0;
+}
+
+bool FrameStoreReader::isOpened() const noexcept
+{
+    return m_data != nullptr;
+}
+
+int FrameStoreReader::frames() const noexcept
+{
+    return static_cast<int>(m_entries.size());
+}
+
+double FrameStoreReader::fps() const noexcept
+{
+    return m_fps;
+}
+
+cv::Mat FrameStoreReader::frame(int frameNum) const
+{
+    if ( frameNum < 0 || frameNum >= frames() )
+    {
+        return cv::Mat();
+    }
+
+    const FrameStoreEntry& entry = m_entries[frameNum];
+    return cv::Mat(entry.rows, entry.cols, entry.type, m_data + entry.offset);
+}
+
+std::int64_t FrameStoreReader::timestamp(int frameNum) const
+{
+    if ( frameNum < 0 || frameNum >= frames() )
+    {
+        return -1;
+    }
+    return m_entries[frameNum].timestamp;
+}
+
+std::string FrameStoreReader::indexPath(const std::string& path)
+{
+    return path + ".idx";
+}
+
+}
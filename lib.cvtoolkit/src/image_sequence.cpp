@@ -0,0 +1,233 @@
+#include "cvtoolkit/image_sequence.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+#include "cvtoolkit/cvplayer.hpp"
+
+namespace fs = std::filesystem;
+
+namespace cvt
+{
+
+namespace
+{
+
+bool isImageFile(const std::string& path)
+{
+    std::string ext = fs::path(path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return ext == ".jpeg" || 
+        std::find(supportedImageContainers.begin(), supportedImageContainers.end(), ext) != supportedImageContainers.end();
+}
+
+}
+
+ImageSequenceReader::ImageSequenceReader(const std::string& pattern, cv::Size size, double scaleFactor, 
+                                         int decodeThreads, int lookahead)
+    : m_size(size)
+    , m_scaleFactor(scaleFactor)
+{
+    std::vector<cv::String> files;
+    cv::glob(pattern, files, false);
+    for ( const auto& file : files )
+    {
+        if ( isImageFile(file) )
+        {
+            m_paths.emplace_back(file);
+        }
+    }
+    if ( m_paths.empty() )
+    {
+        std::cerr << ">>> [ImageSequenceReader] No images found in " << pattern << std::endl;
+        return;
+    }
+
+    /* Modification times are the only timestamps snapshots carry */
+    m_mtimes.reserve(m_paths.size());
+    for ( const auto& path : m_paths )
+    {
+        std::error_code ec;
+        const auto mtime = fs::last_write_time(path, ec);
+        m_mtimes.emplace_back( ec ? 0 : std::chrono::duration_cast<std::chrono::milliseconds>(mtime.time_since_epoch()).count() );
+    }
+
+    if ( decodeThreads <= 0 )
+    {
+        decodeThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    if ( lookahead <= 0 )
+    {
+        lookahead = 2 * decodeThreads;
+    }
+    m_slots.resize(lookahead);
+
+    for ( int i = 0; i < decodeThreads; ++i )
+    {
+        m_workers.emplace_back(&ImageSequenceReader::workerLoop, this);
+    }
+}
+
+ImageSequenceReader::~ImageSequenceReader()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_space.notify_all();
+    for ( auto& worker : m_workers )
+    {
+        if ( worker.joinable() )
+        {
+            worker.join();
+        }
+    }
+}
+
+bool ImageSequenceReader::isSequence(const std::string& input)
+{
+    /* Stream URLs may contain '?' as well */
+    if ( input.find("://") != std::string::npos )
+    {
+        return false;
+    }
+    if ( input.find_first_of("*?") != std::string::npos )
+    {
+        return true;
+    }
+    std::error_code ec;
+    return fs::is_directory(input, ec);
+}
+
+bool ImageSequenceReader::isOpened() const noexcept
+{
+    return !m_paths.empty();
+}
+
+int ImageSequenceReader::frames() const noexcept
+{
+    return static_cast<int>(m_paths.size());
+}
+
+bool ImageSequenceReader::read(cv::Mat& out)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    while ( m_next < frames() )
+    {
+        Slot& slot = m_slots[m_next % m_slots.size()];
+        m_ready.wait(lock, [this, &slot]{ return slot.frameNum == m_next; });
+
+        const bool skipped = slot.skipped;
+        if ( !skipped )
+        {
+            cv::swap(out, slot.image);
+        }
+        slot.frameNum = -1;
+        slot.skipped = false;
+        ++m_next;
+        m_space.notify_all();
+        if ( !skipped )
+        {
+            return true;
+        }
+    }
+
+    out.release();
+    return false;
+}
+
+int ImageSequenceReader::position() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_next;
+}
+
+void ImageSequenceReader::seek(int frameNum)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_epoch;
+    m_next = std::min(std::max(frameNum, 0), frames());
+    m_dispatched = m_next;
+    for ( auto& slot : m_slots )
+    {
+        slot.frameNum = -1;
+    }
+    m_space.notify_all();
+}
+
+void ImageSequenceReader::setFrameRate(double fps)
+{
+    m_fps = std::max(fps, 0.0);
+}
+
+std::int64_t ImageSequenceReader::timestamp(int frameNum) const
+{
+    if ( frameNum < 0 || frameNum >= frames() )
+    {
+        return -1;
+    }
+    if ( m_fps > 0.0 )
+    {
+        return static_cast<std::int64_t>(1000.0 * frameNum / m_fps);
+    }
+    return m_mtimes[frameNum] - m_mtimes[0];
+}
+
+const std::string& ImageSequenceReader::path(int frameNum) const
+{
+    return m_paths.at(frameNum);
+}
+
+void ImageSequenceReader::workerLoop()
+{
+    pinToBudget(threadBudget().opencv.cores);
+    const int capacity = static_cast<int>(m_slots.size());
+    cv::Mat image;
+    while ( true )
+    {
+        int frameNum = 0;
+        int epoch = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_space.wait(lock, [this, capacity]{ 
+                return m_stop || (m_dispatched < frames() && m_dispatched < m_next + capacity); 
+            });
+            if ( m_stop )
+            {
+                break;
+            }
+            frameNum = m_dispatched++;
+            epoch = m_epoch;
+        }
+
+        image = cv::imread(m_paths[frameNum], cv::IMREAD_COLOR);
+        if ( image.empty() )
+        {
+            std::cerr << ">>> [ImageSequenceReader] Could not read " << m_paths[frameNum] << ", skipping it" << std::endl;
+        }
+        else if ( !m_size.empty() && image.size() != m_size )
+        {
+            cv::resize(image, image, m_size);
+        }
+        else if ( m_size.empty() && m_scaleFactor != 1.0 )
+        {
+            cv::resize(image, image, cv::Size(0, 0), m_scaleFactor, m_scaleFactor);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if ( epoch != m_epoch )
+        {
+            continue;
+        }
+        /* The slot is free: frame (frameNum - capacity) has already been read */
+        Slot& slot = m_slots[frameNum % capacity];
+        slot.skipped = image.empty();
+        cv::swap(slot.image, image);
+        slot.frameNum = frameNum;
+        m_ready.notify_all();
+    }
+}
+
+}
@@ -0,0 +1,279 @@
+#include "cvtoolkit/ingest.hpp"
+
+#include <algorithm>
+
+namespace cvt
+{
+
+namespace
+{
+
+/* BT.601 luma coefficients in Q14 fixed point, the same ones cv::cvtColor uses */
+const int YB = 1868;
+const int YG = 9617;
+const int YR = 4899;
+const int YShift = 14;
+
+/*! @brief Box-averaging downscale of a BGR frame into BGR and/or gray planes.
+
+    Source footprints of neighbouring output pixels do not overlap, so every source pixel is read exactly once.
+    The loop runs over stripes of output rows, and every stripe accumulates into its own preallocated row.
+*/
+class AreaDownscaleBody final : public cv::ParallelLoopBody
+{
+public:
+    AreaDownscaleBody(const cv::Mat& src, cv::Mat* bgr, cv::Mat* gray, 
+                        const std::vector<int>& xofs, const std::vector<int>& yofs,
+                        std::vector<std::vector<int>>& stripeAcc, int stripes)
+        : m_src(src)
+        , m_bgr(bgr)
+        , m_gray(gray)
+        , m_xofs(xofs)
+        , m_yofs(yofs)
+        , m_stripeAcc(stripeAcc)
+        , m_stripes(stripes)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        const int dstH = static_cast<int>(m_yofs.size()) - 1;
+        for ( int stripe = range.start; stripe < range.end; ++stripe )
+        {
+            processRows(stripe * dstH / m_stripes, (stripe + 1) * dstH / m_stripes, m_stripeAcc[stripe]);
+        }
+    }
+
+private:
+    const cv::Mat& m_src;
+    cv::Mat* m_bgr;
+    cv::Mat* m_gray;
+    const std::vector<int>& m_xofs;
+    const std::vector<int>& m_yofs;
+    std::vector<std::vector<int>>& m_stripeAcc;
+    const int m_stripes;
+
+    void processRows(int yBegin, int yEnd, std::vector<int>& acc) const
+    {
+        const int dstW = static_cast<int>(m_xofs.size()) - 1;
+        for ( int y = yBegin; y < yEnd; ++y )
+        {
+            std::fill(acc.begin(), acc.begin() + 3 * dstW, 0);
+
+            const int sy0 = m_yofs[y];
+            const int sy1 = m_yofs[y + 1];
+            for ( int sy = sy0; sy < sy1; ++sy )
+            {
+                const uchar* s = m_src.ptr<uchar>(sy);
+                int* a = acc.data();
+                for ( int x = 0; x < dstW; ++x, a += 3 )
+                {
+                    int b = 0, g = 0, r = 0;
+                    for ( int sx = m_xofs[x]; sx < m_xofs[x + 1]; ++sx )
+                    {
+                        b += s[3 * sx];
+                        g += s[3 * sx + 1];
+                        r += s[3 * sx + 2];
+                    }
+                    a[0] += b;
+                    a[1] += g;
+                    a[2] += r;
+                }
+            }
+
+            uchar* dBgr = m_bgr ? m_bgr->ptr<uchar>(y) : nullptr;
+            uchar* dGray = m_gray ? m_gray->ptr<uchar>(y) : nullptr;
+            const int footprintRows = sy1 - sy0;
+            const int* a = acc.data();
+            for ( int x = 0; x < dstW; ++x, a += 3 )
+            {
+                const int area = footprintRows * (m_xofs[x + 1] - m_xofs[x]);
+                const int half = area / 2;
+                const int b = (a[0] + half) / area;
+                const int g = (a[1] + half) / area;
+                const int r = (a[2] + half) / area;
+                if ( dBgr )
+                {
+                    dBgr[3 * x] = static_cast<uchar>(b);
+                    dBgr[3 * x + 1] = static_cast<uchar>(g);
+                    dBgr[3 * x + 2] = static_cast<uchar>(r);
+                }
+                if ( dGray )
+                {
+                    dGray[x] = static_cast<uchar>((b * YB + g * YG + r * YR + (1 << (YShift - 1))) >> YShift);
+                }
+            }
+        }
+    }
+};
+
+/*! @brief Splits [0, srcLen) into dstLen non-overlapping whole-pixel footprints.
+
+    With a fractional ratio footprints differ in size by one pixel, and an edge pixel falls to one of them
+    instead of being shared by weight as cv::INTER_AREA does.
+*/
+void makeFootprints(int srcLen, int dstLen, std::vector<int>& ofs)
+{
+    ofs.resize(dstLen + 1);
+    for ( int i = 0; i <= dstLen; ++i )
+    {
+        ofs[i] = static_cast<int>((static_cast<std::int64_t>(i) * srcLen) / dstLen);
+    }
+}
+
+/*! @brief Generic path for upscaling, same size and gray sources.
+*/
+void producePlane(const cv::Mat& src, const PlaneSpec& spec, cv::Mat& out)
+{
+    const bool srcGray = (src.channels() == 1);
+    if ( spec.format == PlaneSpec::Format::BGR )
+    {
+        if ( srcGray )
+        {
+            cv::cvtColor(src, out, cv::COLOR_GRAY2BGR);
+            if ( out.size() != spec.size )
+                cv::resize(out, out, spec.size, 0.0, 0.0, cv::INTER_AREA);
+        }
+        else if ( src.size() == spec.size )
+        {
+            out = src; // no need to copy
+        }
+        else
+        {
+            cv::resize(src, out, spec.size, 0.0, 0.0, cv::INTER_AREA);
+        }
+    }
+    else
+    {
+        if ( srcGray )
+        {
+            if ( src.size() == spec.size )
+                out = src;
+            else
+                cv::resize(src, out, spec.size, 0.0, 0.0, cv::INTER_AREA);
+        }
+        else
+        {
+            cv::cvtColor(src, out, cv::COLOR_BGR2GRAY);
+            if ( out.size() != spec.size )
+                cv::resize(out, out, spec.size, 0.0, 0.0, cv::INTER_AREA);
+        }
+    }
+}
+
+}
+
+
+IngestStage::IngestStage(const PlaneSpecs& specs)
+{
+    require(specs);
+}
+
+void IngestStage::require(const PlaneSpec& spec)
+{
+    if ( spec.size.empty() )
+    {
+        return;
+    }
+    if ( std::find(m_specs.begin(), m_specs.end(), spec) != m_specs.end() )
+    {
+        return;
+    }
+    m_specs.emplace_back(spec);
+
+    auto group = std::find_if(m_groups.begin(), m_groups.end(), [&spec](const Group& g) { return g.size == spec.size; });
+    if ( group == m_groups.end() )
+    {
+        group = m_groups.emplace(m_groups.end());
+        group->size = spec.size;
+    }
+    const int index = static_cast<int>(m_specs.size()) - 1;
+    ( spec.format == PlaneSpec::Format::GRAY ? group->gray : group->bgr ) = index;
+}
+
+void IngestStage::require(const PlaneSpecs& specs)
+{
+    for ( const auto& spec : specs )
+    {
+        require(spec);
+    }
+}
+
+const PlaneSpecs& IngestStage::specs() const noexcept
+{
+    return m_specs;
+}
+
+bool IngestStage::empty() const noexcept
+{
+    return m_specs.empty();
+}
+
+void IngestStage::process(const cv::Mat& src, FramePlanes& out)
+{
+    out.clear();
+    if ( src.empty() || m_specs.empty() )
+    {
+        return;
+    }
+
+    out.specs = m_specs;
+    out.planes.resize(m_specs.size());
+
+    for ( auto& group : m_groups )
+    {
+        const cv::Size dstSize = group.size;
+        const bool downscale = (src.type() == CV_8UC3 && dstSize != src.size()
+                                && dstSize.width <= src.cols && dstSize.height <= src.rows);
+        if ( !downscale )
+        {
+            for ( const int i : { group.bgr, group.gray } )
+            {
+                if ( i >= 0 )
+                {
+                    producePlane(src, m_specs[i], out.planes[i]);
+                }
+            }
+            continue;
+        }
+
+        /* Every plane of this size is produced in one pass */
+        cv::Mat* bgr = nullptr;
+        cv::Mat* gray = nullptr;
+        if ( group.bgr >= 0 )
+        {
+            bgr = &out.planes[group.bgr];
+            bgr->create(dstSize, CV_8UC3);
+        }
+        if ( group.gray >= 0 )
+        {
+            gray = &out.planes[group.gray];
+            gray->create(dstSize, CV_8UC1);
+        }
+
+        /* Footprints depend on the source size only */
+        if ( group.srcSize != src.size() )
+        {
+            makeFootprints(src.cols, dstSize.width, group.xofs);
+            makeFootprints(src.rows, dstSize.height, group.yofs);
+            group.srcSize = src.size();
+        }
+
+        /* Accumulators only grow, so they are allocated on the first frames */
+        const int stripes = std::max(1, std::min(dstSize.height, cv::getNumThreads()));
+        if ( static_cast<int>(m_stripeAcc.size()) < stripes )
+        {
+            m_stripeAcc.resize(stripes);
+        }
+        for ( int k = 0; k < stripes; ++k )
+        {
+            if ( m_stripeAcc[k].size() < static_cast<size_t>(3 * dstSize.width) )
+            {
+                m_stripeAcc[k].resize(3 * dstSize.width);
+            }
+        }
+        cv::parallel_for_(cv::Range(0, stripes), AreaDownscaleBody(src, bgr, gray, group.xofs, group.yofs, m_stripeAcc, stripes));
+    }
+}
+
+}
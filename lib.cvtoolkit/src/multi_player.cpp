@@ -0,0 +1,232 @@
+#include "cvtoolkit/multi_player.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <chrono>
+
+namespace cvt
+{
+
+MultiSourcePlayer::MultiSourcePlayer(const std::vector<std::string>& inputs, cv::Size inputSize, 
+                                        int decodeThreads, int maxPendingFrames)
+    : m_decodeThreads( (decodeThreads > 0) 
+                        ? decodeThreads 
+                        : std::max(1, std::min(static_cast<int>(std::thread::hardware_concurrency()), static_cast<int>(inputs.size()))) )
+    , m_maxPendingFrames(std::max(maxPendingFrames, 1))
+{
+    m_streams.reserve(inputs.size());
+    for ( const auto& input : inputs )
+    {
+        auto stream = std::make_unique<Stream>();
+        stream->stats.input = input;
+        stream->player = inputSize.empty()
+                        ? std::make_shared<OpenCVPlayer>(input)
+                        : std::make_shared<OpenCVPlayer>(input, inputSize);
+
+        const int inputType = stream->player->getInputType(input);
+        stream->live = (inputType == OpenCVPlayer::InputType::LIVESTREAM || inputType == OpenCVPlayer::InputType::WEBCAM);
+
+        const cv::Mat& frame0 = stream->player->frame0();
+        if ( frame0.empty() )
+        {
+            std::cerr << ">>> [MultiSourcePlayer] Could not open " << input << std::endl;
+            stream->finished = true;
+            stream->stats.finished = true;
+        }
+        else
+        {
+            /* Pending frames plus the one being decoded plus the one held by the consumer */
+            stream->pool = std::make_shared<FramePool>(frame0.size(), frame0.type(), m_maxPendingFrames + 2);
+        }
+
+        m_streams.emplace_back(std::move(stream));
+    }
+}
+
+MultiSourcePlayer::~MultiSourcePlayer()
+{
+    stop();
+}
+
+void MultiSourcePlayer::start()
+{
+    if ( m_running )
+    {
+        return;
+    }
+
+    m_running = true;
+    m_workers.reserve(m_decodeThreads);
+    for ( int i = 0; i < m_decodeThreads; ++i )
+    {
+        m_workers.emplace_back(&MultiSourcePlayer::workerLoop, this);
+    }
+}
+
+void MultiSourcePlayer::stop()
+{
+    m_running = false;
+    m_idleCondition.notify_all();
+    for ( auto& worker : m_workers )
+    {
+        if ( worker.joinable() )
+        {
+            worker.join();
+        }
+    }
+    m_workers.clear();
+}
+
+bool MultiSourcePlayer::read(StreamFrame& out, std::int64_t waitForMs)
+{
+    auto item = m_queue.pop1(waitForMs);
+    if ( !item )
+    {
+        return false;
+    }
+
+    out = std::move(*item);
+    --m_streams[out.streamId]->pending;
+    m_idleCondition.notify_one();
+    return true;
+}
+
+int MultiSourcePlayer::streams() const noexcept
+{
+    return static_cast<int>(m_streams.size());
+}
+
+bool MultiSourcePlayer::finished() const
+{
+    for ( const auto& stream : m_streams )
+    {
+        if ( !stream->finished )
+        {
+            return false;
+        }
+    }
+    return m_queue.empty();
+}
+
+MultiSourcePlayer::StreamStats MultiSourcePlayer::stats(int streamId) const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    return m_streams.at(streamId)->stats;
+}
+
+std::string MultiSourcePlayer::summary() const
+{
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    std::stringstream ss;
+    ss << "Streams: " << m_streams.size() << ", decode threads: " << m_decodeThreads;
+    for ( size_t i = 0; i < m_streams.size(); ++i )
+    {
+        const auto& stats = m_streams[i]->stats;
+        ss << std::endl << "\t#" << i << " " << stats.input
+            << ": frames: " << stats.frames
+            << ", dropped: " << stats.dropped
+            << ", fps: " << stats.fps
+            << (stats.finished ? ", finished" : "");
+    }
+
+    return ss.str();
+}
+
+const std::shared_ptr<OpenCVPlayer>& MultiSourcePlayer::player(int streamId) const
+{
+    return m_streams.at(streamId)->player;
+}
+
+void MultiSourcePlayer::workerLoop()
+{
+    using namespace std::chrono_literals;
+    pinToBudget(threadBudget().opencv.cores);
+
+    const unsigned int nStreams = static_cast<unsigned int>(m_streams.size());
+    while ( m_running && nStreams > 0 )
+    {
+        /* Visit every stream at most once starting from the shared cursor, so that all workers together go round-robin */
+        bool served = false;
+        for ( unsigned int k = 0; k < nStreams && !served; ++k )
+        {
+            const int streamId = static_cast<int>(m_cursor.fetch_add(1) % nStreams);
+            Stream& stream = *m_streams[streamId];
+            if ( stream.finished )
+            {
+                continue;
+            }
+
+            /* A capture must not be used by two threads at once */
+            bool expected = false;
+            if ( !stream.busy.compare_exchange_strong(expected, true) )
+            {
+                continue;
+            }
+            served = serve(stream, streamId);
+            stream.busy = false;
+        }
+
+        if ( !served )
+        {
+            std::unique_lock<std::mutex> lock(m_idleMutex);
+            m_idleCondition.wait_for(lock, 10ms);
+        }
+    }
+}
+
+bool MultiSourcePlayer::serve(Stream& stream, int streamId)
+{
+    FrameHandle frame;
+    if ( stream.pending < m_maxPendingFrames )
+    {
+        frame = stream.pool->acquire();
+    }
+
+    if ( !frame )
+    {
+        if ( !stream.live )
+        {
+            return false; // a recorded input just waits for the consumer
+        }
+
+        /* Keep draining a live source, otherwise its buffer and latency grow */
+        const bool retval = stream.player->grab();
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        ++stream.stats.dropped;
+        if ( !retval )
+        {
+            stream.finished = true;
+            stream.stats.finished = true;
+        }
+        return true;
+    }
+
+    *stream.player >> frame;
+    if ( frame->image.empty() )
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stream.finished = true;
+        stream.stats.finished = true;
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        const std::int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        if ( stream.lastDeliveryTick >= 0 && now > stream.lastDeliveryTick )
+        {
+            const double instantFps = 1e6 / static_cast<double>(now - stream.lastDeliveryTick);
+            stream.stats.fps = (stream.stats.fps > 0.0) ? 0.9 * stream.stats.fps + 0.1 * instantFps : instantFps;
+        }
+        stream.lastDeliveryTick = now;
+        ++stream.stats.frames;
+    }
+
+    ++stream.pending;
+    const std::int64_t timestamp = frame->timestamp;
+    m_queue.push(StreamFrame{ streamId, timestamp, std::move(frame) });
+    return true;
+}
+
+}
@@ -1,7 +1,9 @@
 #include <cassert>
+#include <stdexcept>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/dnn.hpp>
 #include "cvtoolkit/utils.hpp"
+#include "cvtoolkit/thread_budget.hpp"
 #include "cvtoolkit/nn/efficientnet.hpp"
 
 namespace cvt
@@ -280,8 +282,13 @@ EfficientNet_Onnx::EfficientNet_Onnx(const InitializeData& initializeData)
     : NeuralNetwork(initializeData)
 {
     Ort::Env env(OrtLoggingLevel::ORT_LOGGING_LEVEL_WARNING, "EfficientNet_Onnx");
+    const ThreadBudget& budget = threadBudget();
     Ort::SessionOptions sessionOptions;
-    sessionOptions.SetInterOpNumThreads(1);
+    sessionOptions.SetInterOpNumThreads(std::max(1, budget.inferenceInterOpThreads));
+    if ( budget.inference.threads > 0 )
+    {
+        sessionOptions.SetIntraOpNumThreads(budget.inference.threads);
+    }
 
     // Sets graph optimization level
     // Available levels are
@@ -300,7 +307,24 @@ EfficientNet_Onnx::EfficientNet_Onnx(const InitializeData& initializeData)
             cv::TickMeter loadModelTm;
             loadModelTm.start();
 
-            m_session = Ort::Session(env, initializeData.modelPath.c_str(), sessionOptions);
+            /* The session spawns its thread pool right away, let it be born on the inference cores
+               (on all of them rather than on the cores of whichever thread creates the session) */
+            std::string sessionError;
+            runPinned(budgetCores(budget.inference.cores), [&]()
+            {
+                try
+                {
+                    m_session = Ort::Session(env, initializeData.modelPath.c_str(), sessionOptions);
+                }
+                catch ( const std::exception& e )
+                {
+                    sessionError = e.what();
+                }
+            });
+            if ( !sessionError.empty() )
+            {
+                throw std::runtime_error(sessionError);
+            }
 
             loadModelTm.stop();
             std::cout << "[EfficientNet_Onnx] Model loading took " << loadModelTm.getAvgTimeMilli() << "ms" << std::endl;
@@ -1,4 +1,5 @@
 #include "cvtoolkit/nndetector.hpp"
+#include "cvtoolkit/utils.hpp"
 
 #include <fstream>
 #include <sstream>
@@ -6,6 +7,24 @@
 namespace cvt
 {
 
+void NNDetector::internClassNames( const ObjectClasses& classes )
+{
+    m_classNames.clear();
+    for ( const auto& objectClass : classes )
+    {
+        if ( objectClass.first < 0 )
+        {
+            continue;
+        }
+        if ( objectClass.first >= static_cast<int>(m_classNames.size()) )
+        {
+            m_classNames.resize(objectClass.first + 1);
+        }
+        m_classNames[objectClass.first] = internClassName(objectClass.second);
+    }
+}
+
+
 void ImageNNClassifier::readObjectClasses( const std::string& classPath )
 {
     std::ifstream ifs(classPath.c_str());
@@ -21,6 +40,7 @@ void ImageNNClassifier::readObjectClasses( const std::string& classPath )
         m_objectClasses[lineId] = line;
         ++lineId;
     }
+    internClassNames(m_objectClasses);
 }
 
 const ObjectClasses& ImageNNClassifier::objectClasses() const noexcept
@@ -28,13 +48,9 @@ const ObjectClasses& ImageNNClassifier::objectClasses() const noexcept
     return m_objectClasses;
 }
 
-inline std::string ImageNNClassifier::getClassName( int classId )
+inline std::string_view ImageNNClassifier::getClassName( int classId )
 {
-    if ( m_objectClasses.empty() )
-    {
-        return "";
-    }
-    return m_objectClasses[classId];
+    return className(classId);
 }
 
 
@@ -102,6 +118,7 @@ void MaskRCNNObjectDetector::readObjectClasses( const std::string& classPath )
         m_objectClasses[lineId] = line;
         ++lineId;
     }
+    internClassNames(m_objectClasses);
 }
 
 inline void MaskRCNNObjectDetector::preprocess( const cv::Mat& frame )
@@ -167,13 +184,9 @@ void MaskRCNNObjectDetector::postprocess( const cv::Mat& frame, const std::vecto
     }
 }
 
-inline std::string MaskRCNNObjectDetector::getClassName( int classId )
+inline std::string_view MaskRCNNObjectDetector::getClassName( int classId )
 {
-    if ( m_objectClasses.empty() )
-    {
-        return "";
-    }
-    return m_objectClasses[classId];
+    return className(classId);
 }
 
 
@@ -207,12 +220,37 @@ YOLOObjectNNDetector::YOLOObjectNNDetector( const std::string& cfgPath, const st
 
 void YOLOObjectNNDetector::Infer( const cv::Mat& frame, InferOuts& out, float confThreshold, const ObjectClasses& acceptedClasses )
 {
-    preprocess( frame );
+    cv::Mat blob;
+    Preprocess( frame, blob );
 
     std::vector<cv::Mat> outLayers;
-    m_net.forward( outLayers, m_outNames );
+    Forward( blob, outLayers );
 
-    postprocess( frame, outLayers, out, confThreshold, acceptedClasses );
+    Postprocess( frame.size(), outLayers, out, confThreshold, acceptedClasses );
+}
+
+void YOLOObjectNNDetector::InferBatch( const std::vector<cv::Mat>& frames, std::vector<InferOuts>& outs, 
+                                       float confThreshold, const ObjectClasses& acceptedClasses )
+{
+    outs.clear();
+    if ( frames.empty() )
+    {
+        return;
+    }
+
+    cv::Mat blob;
+    PreprocessBatch( frames, blob );
+
+    std::vector<cv::Mat> outLayers;
+    Forward( blob, outLayers );
+
+    std::vector<cv::Size> frameSizes;
+    frameSizes.reserve(frames.size());
+    for ( const auto& frame : frames )
+    {
+        frameSizes.emplace_back(frame.size());
+    }
+    PostprocessBatch( frameSizes, outLayers, outs, confThreshold, acceptedClasses );
 }
 
 void YOLOObjectNNDetector::Filter( const InferOuts& in, InferOuts& out, const ObjectClasses& acceptedClasses )
@@ -245,23 +283,75 @@ void YOLOObjectNNDetector::readObjectClasses( const std::string& classPath )
         m_objectClasses[lineId] = line;
         ++lineId;
     }
+    internClassNames(m_objectClasses);
 }
 
-inline void YOLOObjectNNDetector::preprocess( const cv::Mat& frame )
+void YOLOObjectNNDetector::Preprocess( const cv::Mat& frame, cv::Mat& blob ) const
 {
-    static cv::Mat blob;
     // Create a 4D blob from a frame.
     cv::dnn::blobFromImage(frame, blob, 1.0 / 255.0, cv::Size(416, 416), cv::Scalar(), true, false);
+}
 
+void YOLOObjectNNDetector::Forward( const cv::Mat& blob, std::vector<cv::Mat>& outs )
+{
     m_net.setInput(blob);
+    m_net.forward( outs, m_outNames );
 }
 
-void YOLOObjectNNDetector::postprocess( const cv::Mat& frame, const std::vector<cv::Mat>& outs, 
-                InferOuts& inferOuts, float confThreshold, const ObjectClasses& acceptedClasses )
+void YOLOObjectNNDetector::PreprocessBatch( const std::vector<cv::Mat>& frames, cv::Mat& blob ) const
+{
+    cv::dnn::blobFromImages(frames, blob, 1.0 / 255.0, cv::Size(416, 416), cv::Scalar(), true, false);
+}
+
+void YOLOObjectNNDetector::PostprocessBatch( const std::vector<cv::Size>& frameSizes, const std::vector<cv::Mat>& outs, 
+                std::vector<InferOuts>& inferOuts, float confThreshold, const ObjectClasses& acceptedClasses ) const
+{
+    const int batchSize = static_cast<int>(frameSizes.size());
+    inferOuts.resize(frameSizes.size());
+    for ( auto& frameOuts : inferOuts )
+    {
+        frameOuts.clear(); // keeps capacity for the next batch
+    }
+    if ( batchSize == 1 )
+    {
+        Postprocess( frameSizes[0], outs, inferOuts[0], confThreshold, acceptedClasses );
+        return;
+    }
+
+    /* Depending on OpenCV version, a batched output layer is either N x rows x cols or (N * rows) x cols */
+    thread_local std::vector<cv::Mat> imageLayers;
+    imageLayers.resize(outs.size());
+    for ( int b = 0; b < batchSize; ++b )
+    {
+        for ( size_t i = 0; i < outs.size(); ++i )
+        {
+            const cv::Mat& layer = outs[i];
+            if ( layer.dims == 3 )
+            {
+                imageLayers[i] = cv::Mat(layer.size[1], layer.size[2], layer.type(), const_cast<uchar*>(layer.ptr(b)));
+            }
+            else
+            {
+                const int rows = layer.rows / batchSize;
+                imageLayers[i] = layer.rowRange(b * rows, (b + 1) * rows);
+            }
+        }
+        Postprocess( frameSizes[b], imageLayers, inferOuts[b], confThreshold, acceptedClasses );
+    }
+    imageLayers.clear();
+}
+
+void YOLOObjectNNDetector::Postprocess( cv::Size frameSize, const std::vector<cv::Mat>& outs, 
+                InferOuts& inferOuts, float confThreshold, const ObjectClasses& acceptedClasses ) const
 {
-    std::vector<int> classIds;
-	std::vector<float> confidences;
-	std::vector<cv::Rect> boxes;
+    /* Postprocessing may run on several stage threads at once, so every thread reuses its own buffers */
+    thread_local std::vector<int> classIds;
+    thread_local std::vector<float> confidences;
+    thread_local std::vector<cv::Rect> boxes;
+    thread_local std::vector<int> indices;
+    classIds.clear();
+    confidences.clear();
+    boxes.clear();
     for (size_t i = 0; i < outs.size(); ++i)
     {
         // Network produces output blob with a shape NxC where N is a number of
@@ -283,15 +373,15 @@ void YOLOObjectNNDetector::postprocess( const cv::Mat& frame, const std::vector<
             }
             
             // Extract the bounding box
-            int centerX = (int)(data[0] * frame.cols);
-            int centerY = (int)(data[1] * frame.rows);
-            int width = (int)(data[2] * frame.cols);
-            int height = (int)(data[3] * frame.rows);
+            int centerX = (int)(data[0] * frameSize.width);
+            int centerY = (int)(data[1] * frameSize.height);
+            int width = (int)(data[2] * frameSize.width);
+            int height = (int)(data[3] * frameSize.height);
             int left = centerX - width / 2;
             int top = centerY - height / 2;
                 
             /* Cast coords to frame size (if needed) */
-            cv::Rect box = cv::Rect(left, top, width, height) & cv::Rect(cv::Point(0, 0), cv::Point(frame.cols, frame.rows));
+            cv::Rect box = cv::Rect(left, top, width, height) & cv::Rect(cv::Point(0, 0), cv::Point(frameSize.width, frameSize.height));
 
             classIds.push_back(classId);
             confidences.push_back((float)confidence);
@@ -300,7 +390,6 @@ void YOLOObjectNNDetector::postprocess( const cv::Mat& frame, const std::vector<
     }
 
     /* NMS */
-    std::vector<int> indices;
     cv::dnn::NMSBoxes(boxes, confidences, confThreshold, DEFAULT_NMS_THRESH, indices);
     for (size_t i = 0; i < indices.size(); ++i)
     {
@@ -310,13 +399,9 @@ void YOLOObjectNNDetector::postprocess( const cv::Mat& frame, const std::vector<
     }
 }
 
-inline std::string YOLOObjectNNDetector::getClassName( int classId )
+std::string_view YOLOObjectNNDetector::getClassName( int classId ) const
 {
-    if ( m_objectClasses.empty() )
-    {
-        return "";
-    }
-    return m_objectClasses[classId];
+    return className(classId);
 }
 
 }
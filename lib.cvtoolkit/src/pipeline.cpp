@@ -0,0 +1,679 @@
+#include "cvtoolkit/pipeline.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include <opencv2/imgproc.hpp>
+#include <opencv2/highgui.hpp>
+
+#include "cvtoolkit/cvplayer.hpp"
+#include "cvtoolkit/ingest.hpp"
+#include "cvtoolkit/video_writer.hpp"
+#include "cvtoolkit/detector/yolo_object_detector.hpp"
+#include "cvtoolkit/detector/optflow_motion_detector.hpp"
+
+namespace cvt
+{
+
+namespace
+{
+
+constexpr double StatsAlpha = 0.05;
+
+constexpr std::int64_t PopTimeoutMs = 100;
+
+
+/*! @brief Reads frames from OpenCVPlayer into pooled buffers.
+*/
+class SourceStage final : public PipelineStage
+{
+public:
+    SourceStage(const json& params)
+    {
+        const std::string input = params.value("input", std::string("0"));
+        const std::string inputSize = params.value("input-size", std::string());
+        if ( inputSize.empty() )
+        {
+            m_player = std::make_unique<OpenCVPlayer>(input, params.value("resize", 1.0));
+        }
+        else
+        {
+            m_player = std::make_unique<OpenCVPlayer>(input, parseResolution(inputSize));
+        }
+        const cv::Mat& frame0 = m_player->frame0();
+        m_pool = std::make_shared<FramePool>(frame0.size(), frame0.type(), params.value("pool-size", 16));
+    }
+
+    bool isSource() const override
+    {
+        return true;
+    }
+
+    StreamInfo streamInfo(const StreamInfo&) const override
+    {
+        return StreamInfo{ m_player->frame0().size(), m_player->frame0().type(), m_player->fps() };
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        /* Downstream stages may hold all buffers for a while */
+        while ( !item.frame && !stopRequested() )
+        {
+            item.frame = m_pool->acquire(PopTimeoutMs);
+        }
+        if ( !item.frame )
+        {
+            return false;
+        }
+        *m_player >> item.frame;
+        return !item.frame->image.empty();
+    }
+
+private:
+    std::unique_ptr<OpenCVPlayer> m_player;
+    std::shared_ptr<FramePool> m_pool;
+};
+
+
+/*! @brief Produces the planes consumed by the stages below it (see IngestStage).
+*/
+class PreprocessStage final : public PipelineStage
+{
+public:
+    void connect(const PlaneSpecs& downstream) override
+    {
+        m_ingest.require(downstream);
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        if ( !m_ingest.empty() )
+        {
+            m_ingest.process(item.frame->image, item.frame->planes);
+        }
+        return true;
+    }
+
+private:
+    IngestStage m_ingest;
+};
+
+
+/*! @brief Runs a detector and attaches its events to the item.
+*/
+class DetectorStage final : public PipelineStage
+{
+public:
+    DetectorStage(const json& params, const StreamInfo& upstream)
+    {
+        const std::string name = params.value("detector", std::string());
+        Detector::InitializeData iData { name, upstream.size, upstream.fps, params.value("settings", std::string()) };
+        m_detector = Pipeline::createDetector(name, iData);
+    }
+
+    PlaneSpecs requiredPlanes() const override
+    {
+        return m_detector->requiredPlanes();
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        Detector::OutputData out;
+        m_detector->process(Detector::InputData(item.frame), out);
+        if ( out.event )
+        {
+            item.events.emplace_back(std::move(out));
+        }
+        return true;
+    }
+
+private:
+    std::shared_ptr<Detector> m_detector;
+};
+
+
+/*! @brief Draws events over the frame into the item canvas.
+
+    Detectors report events at their own resolution, so "size" should match the detector resolution.
+*/
+class RenderStage final : public PipelineStage
+{
+public:
+    RenderStage(const json& params, const StreamInfo& upstream)
+        : m_size(upstream.size)
+    {
+        const std::string size = params.value("size", std::string());
+        if ( !size.empty() )
+        {
+            m_size = parseResolution(size);
+        }
+    }
+
+    StreamInfo streamInfo(const StreamInfo& upstream) const override
+    {
+        return StreamInfo{ m_size, CV_8UC3, upstream.fps };
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        /* Sibling branches may share the canvas, so always draw into a new one */
+        cv::Mat canvas;
+        const cv::Mat& image = item.frame->image;
+        if ( image.size() == m_size )
+        {
+            canvas = image.clone();
+        }
+        else
+        {
+            cv::resize(image, canvas, m_size);
+        }
+        if ( canvas.channels() == 1 )
+        {
+            cv::cvtColor(canvas, canvas, cv::COLOR_GRAY2BGR);
+        }
+
+        for ( const auto& event : item.events )
+        {
+            for ( const auto& rect : event.eventRects )
+            {
+                cv::rectangle(canvas, rect, cv::Scalar(0, 0, 255), 2);
+            }
+            drawInferOuts(canvas, event.eventInferOuts, cv::Scalar(0, 0, 255), false, true);
+        }
+        item.canvas = canvas;
+        return true;
+    }
+
+private:
+    cv::Size m_size;
+};
+
+
+/*! @brief Shows the canvas (or the frame) in a window. Esc or q stops the pipeline.
+*/
+class DisplayStage final : public PipelineStage
+{
+public:
+    DisplayStage(const json& params)
+        : m_winName(params.value("window", std::string("Pipeline")))
+    {
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        cv::imshow(m_winName, item.canvas.empty() ? item.frame->image : item.canvas);
+        const int key = cv::waitKey(1);
+        if ( key == 27 || key == 'q' )
+        {
+            requestStop();
+        }
+        return true;
+    }
+
+    void finish() override
+    {
+        cv::destroyWindow(m_winName);
+    }
+
+private:
+    const std::string m_winName;
+};
+
+
+/*! @brief Records the canvas (or the frame) with AsyncVideoWriter.
+*/
+class RecordStage final : public PipelineStage
+{
+public:
+    RecordStage(const json& params, const StreamInfo& upstream)
+    {
+        AsyncVideoWriter::Params writerParams;
+        writerParams.path = params.value("path", writerParams.path);
+        writerParams.fourcc = params.value("codec", writerParams.fourcc);
+        writerParams.fps = params.value("fps", upstream.fps);
+        writerParams.queueSize = params.value("queue-size", writerParams.queueSize);
+        if ( params.value("policy", std::string()) == "drop" )
+        {
+            writerParams.policy = AsyncVideoWriter::Policy::DROP;
+        }
+        m_writer = std::make_unique<AsyncVideoWriter>(writerParams);
+    }
+
+    bool process(PipelineItem& item) override
+    {
+        m_writer->write(item.canvas.empty() ? item.frame->image : item.canvas);
+        return true;
+    }
+
+    void finish() override
+    {
+        m_writer->release();
+        std::cout << ">>> " << m_writer->summary() << std::endl;
+    }
+
+private:
+    std::unique_ptr<AsyncVideoWriter> m_writer;
+};
+
+
+/*! @brief Prints events to stdout.
+*/
+class LogStage final : public PipelineStage
+{
+public:
+    bool process(PipelineItem& item) override
+    {
+        for ( const auto& event : item.events )
+        {
+            std::cout << ">>> [EVENT]: " << event.eventDescr << ":";
+            for ( const auto& inferOut : event.eventInferOuts )
+            {
+                std::cout << " " << inferOut.className;
+            }
+            std::cout << " at " << event.eventTimestamp << std::endl;
+        }
+        return true;
+    }
+};
+
+
+struct Registry
+{
+    std::mutex mutex;
+    std::map<std::string, Pipeline::StageCreator> stages;
+    std::map<std::string, Pipeline::DetectorCreator> detectors;
+};
+
+void registerBuiltins(Registry& r)
+{
+    r.stages["source"] = [](const json& params, const StreamInfo&)
+        { return std::make_unique<SourceStage>(params); };
+    r.stages["preprocess"] = [](const json&, const StreamInfo&)
+        { return std::make_unique<PreprocessStage>(); };
+    r.stages["detector"] = [](const json& params, const StreamInfo& upstream)
+        { return std::make_unique<DetectorStage>(params, upstream); };
+    r.stages["render"] = [](const json& params, const StreamInfo& upstream)
+        { return std::make_unique<RenderStage>(params, upstream); };
+    r.stages["display"] = [](const json& params, const StreamInfo&)
+        { return std::make_unique<DisplayStage>(params); };
+    r.stages["record"] = [](const json& params, const StreamInfo& upstream)
+        { return std::make_unique<RecordStage>(params, upstream); };
+    r.stages["log"] = [](const json&, const StreamInfo&)
+        { return std::make_unique<LogStage>(); };
+
+    r.detectors["yolo-object-detector"] = [](const Detector::InitializeData& iData)
+        { return std::make_shared<YOLOObjectDetector>(iData); };
+    r.detectors["optflow-motion-detector"] = [](const Detector::InitializeData& iData)
+        { return std::make_shared<OptflowMotionDetector>(iData); };
+}
+
+Registry& registry()
+{
+    static Registry r;
+    static const bool initialized = ( registerBuiltins(r), true );
+    (void)initialized;
+    return r;
+}
+
+void updateEma(std::atomic<double>& ema, double value)
+{
+    const double prev = ema.load(std::memory_order_relaxed);
+    ema.store(( prev == 0.0 ) ? value : (1.0 - StatsAlpha) * prev + StatsAlpha * value, std::memory_order_relaxed);
+}
+
+}
+
+
+bool PipelineStage::stopRequested() const noexcept
+{
+    return m_stop && m_stop->load(std::memory_order_relaxed);
+}
+
+void PipelineStage::requestStop() noexcept
+{
+    if ( m_stop )
+    {
+        m_stop->store(true);
+    }
+}
+
+
+Pipeline::~Pipeline()
+{
+    stop();
+    wait();
+}
+
+void Pipeline::registerStage(const std::string& type, StageCreator creator)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.stages[type] = std::move(creator);
+}
+
+void Pipeline::registerDetector(const std::string& name, DetectorCreator creator)
+{
+    Registry& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.detectors[name] = std::move(creator);
+}
+
+std::shared_ptr<Detector> Pipeline::createDetector(const std::string& name, const Detector::InitializeData& iData)
+{
+    DetectorCreator creator;
+    {
+        Registry& r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        auto it = r.detectors.find(name);
+        if ( it == r.detectors.end() )
+        {
+            throw std::invalid_argument("unknown detector \"" + name + "\"");
+        }
+        creator = it->second;
+    }
+    return creator(iData);
+}
+
+bool Pipeline::load(const std::string& jPath, const std::string& nodeName)
+{
+    json j = makeJsonObject(jPath);
+    if ( j.empty() || j[nodeName].empty() )
+    {
+        std::cerr << ">>> [Pipeline] Could not find \"" << nodeName << "\" node in " << jPath << std::endl;
+        return false;
+    }
+    return build(j[nodeName]);
+}
+
+bool Pipeline::build(const json& j)
+{
+    if ( m_started )
+    {
+        std::cerr << ">>> [Pipeline] Could not rebuild a started pipeline" << std::endl;
+        return false;
+    }
+    m_nodes.clear();
+
+    if ( !j.contains("stages") || !j["stages"].is_array() || j["stages"].empty() )
+    {
+        std::cerr << ">>> [Pipeline] \"stages\" must be a non-empty array" << std::endl;
+        return false;
+    }
+
+    std::vector<StreamInfo> infos;
+    for ( const auto& jStage : j["stages"] )
+    {
+        auto node = std::make_unique<Node>();
+        node->name = jStage.value("name", "stage" + std::to_string(m_nodes.size()));
+        node->type = jStage.value("type", std::string());
+
+        StageCreator creator;
+        {
+            Registry& r = registry();
+            std::lock_guard<std::mutex> lock(r.mutex);
+            auto it = r.stages.find(node->type);
+            if ( it != r.stages.end() )
+            {
+                creator = it->second;
+            }
+        }
+        if ( !creator )
+        {
+            std::cerr << ">>> [Pipeline] Stage \"" << node->name << "\" has unknown type \"" << node->type << "\"" << std::endl;
+            m_nodes.clear();
+            return false;
+        }
+
+        /* Parents must be declared first, which also rules out cycles */
+        StreamInfo upstream;
+        const std::string from = jStage.value("from", std::string());
+        if ( !from.empty() )
+        {
+            auto it = std::find_if(m_nodes.begin(), m_nodes.end(), [&from](const auto& n) { return n->name == from; });
+            if ( it == m_nodes.end() )
+            {
+                std::cerr << ">>> [Pipeline] Stage \"" << node->name << "\" comes from unknown stage \"" << from << "\"" << std::endl;
+                m_nodes.clear();
+                return false;
+            }
+            node->parent = static_cast<int>(it - m_nodes.begin());
+            upstream = infos[node->parent];
+        }
+
+        try
+        {
+            node->stage = creator(jStage, upstream);
+        }
+        catch ( const std::exception& e )
+        {
+            std::cerr << ">>> [Pipeline] Could not create stage \"" << node->name << "\": " << e.what() << std::endl;
+            m_nodes.clear();
+            return false;
+        }
+        if ( node->stage->isSource() != (node->parent < 0) )
+        {
+            std::cerr << ">>> [Pipeline] Stage \"" << node->name << "\" must "
+                      << (node->stage->isSource() ? "not have" : "have") << " \"from\"" << std::endl;
+            m_nodes.clear();
+            return false;
+        }
+        node->stage->m_stop = &m_stop;
+
+        if ( node->parent >= 0 )
+        {
+            node->policy = ( jStage.value("queue-policy", std::string("block")) == "drop-oldest" )
+                ? QueuePolicy::DROP_OLDEST : QueuePolicy::BLOCK;
+            node->queue = std::make_unique<SpscQueue<PipelineItem>>(jStage.value("queue-size", 8),
+                ( node->policy == QueuePolicy::DROP_OLDEST )
+                    ? SpscQueue<PipelineItem>::OVERWRITE_OLDEST : SpscQueue<PipelineItem>::REJECT_NEWEST);
+            m_nodes[node->parent]->children.emplace_back(static_cast<int>(m_nodes.size()));
+        }
+
+        infos.emplace_back(node->stage->streamInfo(upstream));
+        m_nodes.emplace_back(std::move(node));
+    }
+
+    for ( const auto& node : m_nodes )
+    {
+        node->stage->connect(descendantPlanes(*node));
+    }
+    return true;
+}
+
+bool Pipeline::start()
+{
+    if ( m_nodes.empty() || m_started )
+    {
+        return false;
+    }
+    m_started = true;
+    m_stop = false;
+    for ( auto& node : m_nodes )
+    {
+        node->thread = std::thread(&Pipeline::stageLoop, this, std::ref(*node));
+    }
+    return true;
+}
+
+void Pipeline::stop()
+{
+    m_stop = true;
+    for ( auto& node : m_nodes )
+    {
+        if ( node->queue )
+        {
+            node->queue->finish();
+        }
+    }
+}
+
+void Pipeline::wait()
+{
+    for ( auto& node : m_nodes )
+    {
+        if ( node->thread.joinable() )
+        {
+            node->thread.join();
+        }
+    }
+}
+
+bool Pipeline::running() const noexcept
+{
+    return m_started && std::any_of(m_nodes.begin(), m_nodes.end(), [](const auto& node) { return !node->done; });
+}
+
+std::vector<Pipeline::StageStats> Pipeline::stats() const
+{
+    std::vector<StageStats> result;
+    for ( const auto& node : m_nodes )
+    {
+        StageStats s;
+        s.name = node->name;
+        s.type = node->type;
+        s.processed = node->processed;
+        s.fps = node->fps;
+        s.busyMs = node->busyMs;
+        if ( node->queue )
+        {
+            s.queueDepth = node->queue->size();
+            s.queueCapacity = node->queue->capacity();
+            s.dropped = node->queue->dropped();
+        }
+        result.emplace_back(s);
+    }
+    return result;
+}
+
+std::string Pipeline::summary() const
+{
+    std::ostringstream oss;
+    oss << "[Pipeline]";
+    for ( const auto& s : stats() )
+    {
+        oss << std::endl << "\t- " << s.name << " (" << s.type << "): " << s.processed << " items, "
+            << s.fps << " fps, busy " << s.busyMs << " ms";
+        if ( s.queueCapacity > 0 )
+        {
+            oss << ", queue " << s.queueDepth << "/" << s.queueCapacity << ", dropped " << s.dropped;
+        }
+    }
+    return oss.str();
+}
+
+void Pipeline::stageLoop(Node& node)
+{
+    /* Stages run user code, which belongs to no pool */
+    pinToBudget();
+    const Node* parent = ( node.parent >= 0 ) ? m_nodes[node.parent].get() : nullptr;
+    auto lastItemTime = std::chrono::steady_clock::now();
+    while ( !m_stop )
+    {
+        PipelineItem item;
+        if ( parent && !node.queue->pop1(item, PopTimeoutMs) )
+        {
+            /* Check the flag before the queue: the parent sets it after its last push */
+            if ( !parent->done.load(std::memory_order_acquire) )
+            {
+                continue;
+            }
+            if ( !node.queue->tryPop(item) )
+            {
+                break;
+            }
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        bool keep = false;
+        try
+        {
+            keep = node.stage->process(item);
+        }
+        catch ( const std::exception& e )
+        {
+            std::cerr << ">>> [Pipeline] Stage \"" << node.name << "\" failed: " << e.what() << std::endl;
+            break;
+        }
+        const auto end = std::chrono::steady_clock::now();
+
+        if ( !keep )
+        {
+            if ( !parent )
+            {
+                break; // end of stream
+            }
+            continue;
+        }
+
+        updateEma(node.busyMs, std::chrono::duration<double, std::milli>(end - start).count());
+        if ( node.processed > 0 )
+        {
+            const double intervalSec = std::chrono::duration<double>(end - lastItemTime).count();
+            if ( intervalSec > 0.0 )
+            {
+                updateEma(node.fps, 1.0 / intervalSec);
+            }
+        }
+        lastItemTime = end;
+        ++node.processed;
+
+        forward(node, std::move(item));
+    }
+
+    node.stage->finish();
+    node.done.store(true, std::memory_order_release);
+    for ( int child : node.children )
+    {
+        m_nodes[child]->queue->finish();
+    }
+}
+
+void Pipeline::forward(Node& node, PipelineItem&& item)
+{
+    for ( size_t i = 0; i < node.children.size(); ++i )
+    {
+        Node& child = *m_nodes[node.children[i]];
+        PipelineItem copy = ( i + 1 < node.children.size() ) ? item : std::move(item);
+        if ( child.policy == QueuePolicy::DROP_OLDEST )
+        {
+            child.queue->push(std::move(copy));
+            continue;
+        }
+
+        /* Sleeps until the child takes an item, a refused item stays intact for the next attempt */
+        while ( !child.queue->push(std::move(copy), PopTimeoutMs) )
+        {
+            if ( m_stop || child.done )
+            {
+                break;
+            }
+        }
+    }
+}
+
+PlaneSpecs Pipeline::descendantPlanes(const Node& node) const
+{
+    PlaneSpecs specs;
+    std::vector<int> stack(node.children.begin(), node.children.end());
+    while ( !stack.empty() )
+    {
+        const Node& child = *m_nodes[stack.back()];
+        stack.pop_back();
+        for ( const auto& spec : child.stage->requiredPlanes() )
+        {
+            if ( std::find(specs.begin(), specs.end(), spec) == specs.end() )
+            {
+                specs.emplace_back(spec);
+            }
+        }
+        stack.insert(stack.end(), child.children.begin(), child.children.end());
+    }
+    return specs;
+}
+
+}
@@ -0,0 +1,160 @@
+#include "cvtoolkit/sampling_policy.hpp"
+
+#include <sstream>
+
+
+namespace cvt
+{
+
+namespace
+{
+
+/* Live streams often report no keyframes, so the keyframe policy never goes without a period */
+const std::int64_t KeyframeFallbackPeriodMs = 1000;
+
+}
+
+SamplingSettings SamplingSettings::fromJson(json j, std::int64_t periodMs)
+{
+    SamplingSettings settings;
+    settings.periodMs = periodMs;
+    if ( j.empty() )
+        return settings;
+
+    if ( !j["policy"].empty() )
+    {
+        const std::string policy = j["policy"];
+        if ( policy == "activity" )
+        {
+            settings.policy = Policy::ACTIVITY;
+        }
+        else if ( policy == "keyframe" )
+        {
+            settings.policy = Policy::KEYFRAME;
+        }
+        else if ( policy != "fixed" )
+        {
+            std::cerr << ">>> [SamplingSettings] Unknown policy \"" << policy << "\", fixed is used" << std::endl;
+        }
+    }
+
+    if ( !j["period-ms"].empty() )
+        settings.periodMs = static_cast<std::int64_t>(j["period-ms"]);
+
+    if ( !j["idle-period-ms"].empty() )
+        settings.idlePeriodMs = static_cast<std::int64_t>(j["idle-period-ms"]);
+
+    if ( !j["active-hold-ms"].empty() )
+        settings.activeHoldMs = static_cast<std::int64_t>(j["active-hold-ms"]);
+
+    if ( settings.policy == Policy::KEYFRAME && settings.periodMs <= 0 )
+    {
+        std::cerr << ">>> [SamplingSettings] keyframe policy needs a period for streams without keyframes, "
+                  << KeyframeFallbackPeriodMs << " ms is used" << std::endl;
+        settings.periodMs = KeyframeFallbackPeriodMs;
+    }
+
+    return settings;
+}
+
+
+SamplingPolicy::SamplingPolicy(const SamplingSettings& settings)
+    : m_settings(settings)
+{
+    if ( m_settings.policy == SamplingSettings::Policy::KEYFRAME && m_settings.periodMs <= 0 )
+    {
+        m_settings.periodMs = KeyframeFallbackPeriodMs;
+    }
+}
+
+bool SamplingPolicy::admit(std::int64_t timestamp, bool keyframe)
+{
+    bool admit = false;
+    switch ( m_settings.policy )
+    {
+    case SamplingSettings::Policy::ACTIVITY:
+        admit = periodElapsed(timestamp, active(timestamp) ? m_settings.periodMs : m_settings.idlePeriodMs);
+        break;
+    case SamplingSettings::Policy::KEYFRAME:
+        if ( keyframe )
+        {
+            m_lastAdmittedMs = timestamp;
+            admit = true;
+        }
+        else
+        {
+            /* Without the period a stream with unknown keyframes would never be processed */
+            admit = periodElapsed(timestamp, m_settings.periodMs);
+        }
+        break;
+    default:
+        admit = periodElapsed(timestamp, m_settings.periodMs);
+        break;
+    }
+
+    ++(admit ? m_admitted : m_skipped);
+    return admit;
+}
+
+void SamplingPolicy::observe(std::int64_t timestamp, bool event) noexcept
+{
+    if ( event )
+    {
+        m_lastEventMs.store(timestamp, std::memory_order_relaxed);
+    }
+}
+
+bool SamplingPolicy::active(std::int64_t timestamp) const noexcept
+{
+    const std::int64_t lastEventMs = m_lastEventMs.load(std::memory_order_relaxed);
+    return lastEventMs >= 0 && timestamp - lastEventMs <= m_settings.activeHoldMs;
+}
+
+const SamplingSettings& SamplingPolicy::settings() const noexcept
+{
+    return m_settings;
+}
+
+std::int64_t SamplingPolicy::admitted() const noexcept
+{
+    return m_admitted;
+}
+
+std::int64_t SamplingPolicy::skipped() const noexcept
+{
+    return m_skipped;
+}
+
+std::string SamplingPolicy::summary() const
+{
+    static const char* names[] = { "fixed", "activity", "keyframe" };
+
+    std::ostringstream oss;
+    oss << "[SamplingPolicy] " << names[m_settings.policy] << " sampling: " << m_admitted << " frames admitted, "
+        << m_skipped << " skipped";
+    return oss.str();
+}
+
+bool SamplingPolicy::periodElapsed(std::int64_t timestamp, std::int64_t periodMs)
+{
+    if ( periodMs <= 0 )
+    {
+        m_lastAdmittedMs = timestamp;
+        return true;
+    }
+
+    if ( m_lastAdmittedMs == -1 )
+    {
+        m_lastAdmittedMs = timestamp;
+        return true;
+    }
+
+    if ( timestamp - m_lastAdmittedMs < periodMs )
+    {
+        return false;
+    }
+    m_lastAdmittedMs = timestamp - (timestamp % periodMs);
+    return true;
+}
+
+}
@@ -36,6 +36,20 @@ bool JsonSettings::init(const std::string& nodeName)
         
     if ( !m_jNodeSettings["record"].empty() )
         m_record = static_cast<bool>(m_jNodeSettings["record"]);
+
+    if ( !m_jNodeSettings["record-path"].empty() )
+        m_recordParams.path = static_cast<std::string>(m_jNodeSettings["record-path"]);
+
+    if ( !m_jNodeSettings["record-codec"].empty() )
+        m_recordParams.fourcc = static_cast<std::string>(m_jNodeSettings["record-codec"]);
+
+    if ( !m_jNodeSettings["record-policy"].empty() )
+        m_recordParams.policy = ( static_cast<std::string>(m_jNodeSettings["record-policy"]) == "drop" ) 
+            ? AsyncVideoWriter::Policy::DROP 
+            : AsyncVideoWriter::Policy::BLOCK;
+
+    if ( !m_jNodeSettings["record-queue-size"].empty() )
+        m_recordParams.queueSize = static_cast<int>(m_jNodeSettings["record-queue-size"]);
         
     if ( !m_jNodeSettings["display"].empty() )
         m_display = static_cast<bool>(m_jNodeSettings["display"]);
@@ -43,6 +57,9 @@ bool JsonSettings::init(const std::string& nodeName)
     if ( !m_jNodeSettings["gpu"].empty() )
         m_gpu = static_cast<bool>(m_jNodeSettings["gpu"]);
 
+    if ( !m_jNodeSettings["thread-budget"].empty() )
+        m_threadBudget = ThreadBudget::fromJson(m_jNodeSettings["thread-budget"]);
+
     /* Handle areas */
     m_areas = cvt::parseAreas(m_jNodeSettings["areas"], m_inputSize);
     if ( m_areas.empty() )
@@ -60,6 +77,7 @@ std::string JsonSettings::summary() const noexcept
         << "\t\t- input = " << input() << std::endl
         << "\t\t- inputSize = " << inputSize() << std::endl
         << "\t\t- record = " << record() << std::endl
+        << "\t\t- recordPath = " << m_recordParams.path << " (" << m_recordParams.fourcc << ")" << std::endl
         << "\t\t- display = " << display() << std::endl
         << "\t\t- gpu = " << gpu();
 
@@ -82,6 +100,11 @@ bool JsonSettings::record() const noexcept
     return m_record;
 }
 
+const AsyncVideoWriter::Params& JsonSettings::recordParams() const noexcept
+{
+    return m_recordParams;
+}
+
 bool JsonSettings::display() const noexcept
 {
     return m_display;
@@ -92,6 +115,11 @@ bool JsonSettings::gpu() const noexcept
     return m_gpu;
 }
 
+const ThreadBudget& JsonSettings::threadBudget() const noexcept
+{
+    return m_threadBudget;
+}
+
 
 JsonModelSettings::JsonModelSettings(const std::string& jPath, const std::string& nodeName)
     :m_jModelSettings(makeJsonObject(jPath))
@@ -0,0 +1,214 @@
+#include "cvtoolkit/snapshot.hpp"
+
+#include <fstream>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+namespace cvt
+{
+
+namespace
+{
+
+const char SnapshotMagic[8] = { 'C', 'V', 'T', 'S', 'N', 'A', 'P', '1' };
+
+struct SnapshotHeader
+{
+    char magic[8];
+    std::uint64_t size;
+    std::uint64_t checksum;
+};
+
+/* FNV-1a, enough to tell a torn or damaged file */
+std::uint64_t checksum(const std::vector<char>& data)
+{
+    std::uint64_t hash = 14695981039346656037ull;
+    for ( char c : data )
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+}
+
+
+void SnapshotWriter::write(const cv::Mat& mat)
+{
+    const std::int32_t rows = mat.rows;
+    const std::int32_t cols = mat.cols;
+    const std::int32_t type = mat.type();
+    write(rows);
+    write(cols);
+    write(type);
+    if ( mat.empty() )
+    {
+        return;
+    }
+
+    const std::size_t rowBytes = mat.cols * mat.elemSize();
+    for ( int r = 0; r < mat.rows; ++r )
+    {
+        const char* row = reinterpret_cast<const char*>(mat.ptr(r));
+        m_data.insert(m_data.end(), row, row + rowBytes);
+    }
+}
+
+void SnapshotWriter::write(const std::string& str)
+{
+    const std::uint32_t size = static_cast<std::uint32_t>(str.size());
+    write(size);
+    m_data.insert(m_data.end(), str.begin(), str.end());
+}
+
+void SnapshotWriter::write(const SnapshotWriter& nested)
+{
+    const std::uint64_t size = nested.m_data.size();
+    write(size);
+    m_data.insert(m_data.end(), nested.m_data.begin(), nested.m_data.end());
+}
+
+const std::vector<char>& SnapshotWriter::data() const noexcept
+{
+    return m_data;
+}
+
+void SnapshotWriter::clear() noexcept
+{
+    m_data.clear();
+}
+
+
+SnapshotReader::SnapshotReader(std::vector<char> data)
+    : m_data(std::move(data))
+{
+}
+
+bool SnapshotReader::read(cv::Mat& mat)
+{
+    std::int32_t rows = 0;
+    std::int32_t cols = 0;
+    std::int32_t type = 0;
+    if ( !read(rows) || !read(cols) || !read(type) || rows < 0 || cols < 0 )
+    {
+        m_good = false;
+        return false;
+    }
+    if ( rows == 0 || cols == 0 )
+    {
+        mat.release();
+        return true;
+    }
+
+    const std::size_t bytes = static_cast<std::size_t>(rows) * cols * CV_ELEM_SIZE(type);
+    if ( m_pos + bytes > m_data.size() )
+    {
+        m_good = false;
+        return false;
+    }
+    mat.create(rows, cols, type);
+    std::memcpy(mat.data, m_data.data() + m_pos, bytes);
+    m_pos += bytes;
+    return true;
+}
+
+bool SnapshotReader::read(std::string& str)
+{
+    std::uint32_t size = 0;
+    if ( !read(size) || m_pos + size > m_data.size() )
+    {
+        m_good = false;
+        return false;
+    }
+    str.assign(m_data.data() + m_pos, size);
+    m_pos += size;
+    return true;
+}
+
+bool SnapshotReader::read(SnapshotReader& nested)
+{
+    std::uint64_t size = 0;
+    if ( !read(size) || m_pos + size > m_data.size() )
+    {
+        m_good = false;
+        return false;
+    }
+    nested = SnapshotReader(std::vector<char>(m_data.begin() + m_pos, m_data.begin() + m_pos + size));
+    m_pos += size;
+    return true;
+}
+
+bool SnapshotReader::good() const noexcept
+{
+    return m_good;
+}
+
+bool SnapshotReader::atEnd() const noexcept
+{
+    return m_pos == m_data.size();
+}
+
+
+bool saveSnapshot(const std::string& path, const SnapshotWriter& snapshot)
+{
+    SnapshotHeader header;
+    std::memcpy(header.magic, SnapshotMagic, sizeof(SnapshotMagic));
+    header.size = snapshot.data().size();
+    header.checksum = checksum(snapshot.data());
+
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream ofs(tmpPath, std::ios::binary | std::ios::trunc);
+        if ( !ofs.good() )
+        {
+            return false;
+        }
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.write(snapshot.data().data(), snapshot.data().size());
+        if ( !ofs.good() )
+        {
+            return false;
+        }
+    }
+
+    std::error_code ec;
+    fs::rename(tmpPath, path, ec);
+    return !ec;
+}
+
+bool loadSnapshot(const std::string& path, SnapshotReader& snapshot)
+{
+    std::ifstream ifs(path, std::ios::binary);
+    if ( !ifs.good() )
+    {
+        return false;
+    }
+
+    SnapshotHeader header;
+    ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if ( !ifs || std::memcmp(header.magic, SnapshotMagic, sizeof(SnapshotMagic)) != 0 )
+    {
+        return false;
+    }
+
+    std::error_code ec;
+    const std::uintmax_t fileSize = fs::file_size(path, ec);
+    if ( ec || fileSize != sizeof(header) + header.size )
+    {
+        return false;
+    }
+
+    std::vector<char> data(header.size);
+    ifs.read(data.data(), data.size());
+    if ( !ifs || checksum(data) != header.checksum )
+    {
+        return false;
+    }
+
+    snapshot = SnapshotReader(std::move(data));
+    return true;
+}
+
+}
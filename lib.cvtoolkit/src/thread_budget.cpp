@@ -0,0 +1,331 @@
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <algorithm>
+
+#include <opencv2/core.hpp>
+
+#ifdef TORCH_FOUND
+#include <ATen/Parallel.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace cvt
+{
+
+namespace
+{
+
+ThreadBudget& currentBudget()
+{
+    static ThreadBudget budget;
+    return budget;
+}
+
+/* Cores the process could use when the budget was set */
+std::vector<int>& processCores()
+{
+    static std::vector<int> cores;
+    return cores;
+}
+
+std::vector<int> currentThreadCores()
+{
+    std::vector<int> cores;
+#ifdef _WIN32
+    DWORD_PTR processMask = 0;
+    DWORD_PTR systemMask = 0;
+    if ( GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask) )
+    {
+        for ( int core = 0; core < static_cast<int>(sizeof(DWORD_PTR) * 8); ++core )
+        {
+            if ( processMask & (static_cast<DWORD_PTR>(1) << core) )
+            {
+                cores.emplace_back(core);
+            }
+        }
+    }
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if ( pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0 )
+    {
+        for ( int core = 0; core < CPU_SETSIZE; ++core )
+        {
+            if ( CPU_ISSET(core, &set) )
+            {
+                cores.emplace_back(core);
+            }
+        }
+    }
+#endif
+    return cores;
+}
+
+/* Every stripe pins the worker running it and then waits for the others, so that no worker can take a second
+   stripe and each one gets pinned. The calling thread may run a stripe too, it is not pinned */
+class PinWorkersBody final : public cv::ParallelLoopBody
+{
+public:
+    PinWorkersBody(const std::vector<int>& cores, int stripes)
+        : m_cores(cores)
+        , m_stripes(stripes)
+        , m_caller(std::this_thread::get_id())
+    {}
+
+    void operator()(const cv::Range& range) const override
+    {
+        for ( int r = range.start; r < range.end; ++r )
+        {
+            const bool pinned = ( std::this_thread::get_id() == m_caller ) || pinCurrentThread(m_cores);
+
+            using namespace std::chrono_literals;
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_failed = m_failed || !pinned;
+            ++m_started;
+            m_condition.notify_all();
+            m_condition.wait_for(lock, 200ms, [this]{ return m_started >= m_stripes; });
+        }
+    }
+
+    bool failed() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failed;
+    }
+
+private:
+    const std::vector<int>& m_cores;
+    const int m_stripes;
+    const std::thread::id m_caller;
+    mutable std::mutex m_mutex;
+    mutable std::condition_variable m_condition;
+    mutable int m_started { 0 };
+    mutable bool m_failed { false };
+};
+
+bool pinOpenCVWorkers(const std::vector<int>& cores)
+{
+    const int workers = cv::getNumThreads();
+    if ( cores.empty() || workers <= 1 )
+    {
+        return true;
+    }
+
+    PinWorkersBody body(cores, workers);
+    cv::parallel_for_(cv::Range(0, workers), body, workers);
+    return !body.failed();
+}
+
+ThreadBudget::Pool parsePool(json j)
+{
+    ThreadBudget::Pool pool;
+    if ( j.empty() )
+        return pool;
+
+    if ( !j["cores"].empty() )
+    {
+        for ( int core : j["cores"] )
+            pool.cores.emplace_back(core);
+    }
+
+    if ( !j["threads"].empty() )
+        pool.threads = static_cast<int>(j["threads"]);
+    else
+        pool.threads = static_cast<int>(pool.cores.size());
+
+    return pool;
+}
+
+std::string coresToString(const std::vector<int>& cores)
+{
+    if ( cores.empty() )
+        return "any";
+
+    std::ostringstream oss;
+    for ( size_t i = 0; i < cores.size(); ++i )
+        oss << ( i > 0 ? "," : "" ) << cores[i];
+    return oss.str();
+}
+
+}
+
+
+bool pinCurrentThread(const std::vector<int>& cores)
+{
+    if ( cores.empty() )
+    {
+        return true;
+    }
+
+#ifdef _WIN32
+    DWORD_PTR mask = 0;
+    for ( int core : cores )
+    {
+        if ( core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8) )
+        {
+            mask |= static_cast<DWORD_PTR>(1) << core;
+        }
+    }
+    return mask != 0 && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+#elif defined(__linux__)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for ( int core : cores )
+    {
+        if ( core >= 0 && core < CPU_SETSIZE )
+        {
+            CPU_SET(core, &set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false; // e.g. macOS has no hard affinity
+#endif
+}
+
+void runPinned(const std::vector<int>& cores, const std::function<void()>& func)
+{
+    if ( cores.empty() )
+    {
+        func();
+        return;
+    }
+
+    std::thread thread([&cores, &func]()
+    {
+        pinCurrentThread(cores);
+        func();
+    });
+    thread.join();
+}
+
+
+ThreadBudget ThreadBudget::fromJson(json j)
+{
+    ThreadBudget budget;
+    if ( j.empty() )
+        return budget;
+
+    budget.opencv = parsePool(j["opencv"]);
+    budget.inference = parsePool(j["inference"]);
+    budget.detectors = parsePool(j["detectors"]);
+
+    if ( !j["inference"].empty() && !j["inference"]["inter-op-threads"].empty() )
+        budget.inferenceInterOpThreads = static_cast<int>(j["inference"]["inter-op-threads"]);
+
+    return budget;
+}
+
+bool ThreadBudget::empty() const noexcept
+{
+    return opencv.threads <= 0 && inference.threads <= 0 && detectors.threads <= 0
+        && opencv.cores.empty() && inference.cores.empty() && detectors.cores.empty();
+}
+
+std::string ThreadBudget::summary() const
+{
+    const int hwThreads = static_cast<int>(std::thread::hardware_concurrency());
+
+    std::ostringstream oss;
+    oss << "[ThreadBudget] Thread layout on " << hwThreads << " hardware threads:" << std::endl
+        << "\t- opencv: " << opencv.threads << " threads on cores " << coresToString(opencv.cores) << std::endl
+        << "\t- inference: " << inference.threads << " intra-op + " << inferenceInterOpThreads
+        << " inter-op threads on cores " << coresToString(inference.cores) << std::endl
+        << "\t- detectors: " << detectors.threads << " threads on cores " << coresToString(detectors.cores);
+
+    const int total = opencv.threads + inference.threads + detectors.threads;
+    if ( hwThreads > 0 && total > hwThreads )
+    {
+        oss << std::endl << "\t! " << total << " threads requested, the machine is oversubscribed";
+    }
+
+    const Pool* pools[] = { &opencv, &inference, &detectors };
+    for ( int i = 0; i < 3; ++i )
+    {
+        for ( int k = i + 1; k < 3; ++k )
+        {
+            for ( int core : pools[i]->cores )
+            {
+                if ( std::find(pools[k]->cores.begin(), pools[k]->cores.end(), core) != pools[k]->cores.end() )
+                {
+                    oss << std::endl << "\t! core " << core << " is shared by several pools";
+                }
+            }
+        }
+    }
+
+    return oss.str();
+}
+
+
+void setThreadBudget(const ThreadBudget& budget)
+{
+    currentBudget() = budget;
+
+    if ( budget.opencv.threads > 0 )
+    {
+        cv::setNumThreads(budget.opencv.threads);
+    }
+    if ( processCores().empty() )
+    {
+        processCores() = currentThreadCores();
+    }
+    if ( !pinOpenCVWorkers(budget.opencv.cores) )
+    {
+        std::cerr << ">>> [ThreadBudget] Could not pin OpenCV workers to cores "
+                  << coresToString(budget.opencv.cores) << std::endl;
+    }
+
+#ifdef TORCH_FOUND
+    if ( budget.inference.threads > 0 )
+    {
+        at::set_num_threads(budget.inference.threads);
+    }
+    if ( budget.inferenceInterOpThreads > 0 )
+    {
+        /* Fails if the inter-op pool has already been used */
+        try
+        {
+            at::set_num_interop_threads(budget.inferenceInterOpThreads);
+        }
+        catch ( const std::exception& e )
+        {
+            std::cerr << ">>> [ThreadBudget] Could not set LibTorch inter-op threads: " << e.what() << std::endl;
+        }
+    }
+#endif
+
+    std::cout << ">>> " << budget.summary() << std::endl;
+}
+
+const ThreadBudget& threadBudget() noexcept
+{
+    return currentBudget();
+}
+
+std::vector<int> budgetCores(const std::vector<int>& poolCores)
+{
+    if ( currentBudget().empty() )
+    {
+        return {};
+    }
+    return poolCores.empty() ? processCores() : poolCores;
+}
+
+void pinToBudget(const std::vector<int>& poolCores)
+{
+    pinCurrentThread(budgetCores(poolCores));
+}
+
+}
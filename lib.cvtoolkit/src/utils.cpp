@@ -1,6 +1,9 @@
 #include <cvtoolkit/utils.hpp>
 
 #include <fstream>
+#include <chrono>
+#include <set>
+#include <mutex>
 
 namespace cvt
 {
@@ -122,7 +125,7 @@ void drawInferOut( cv::Mat& frame, const InferOut& inferOut, cv::Scalar color, b
 
     if ( drawLabel )
     {
-        std::string className = ( inferOut.className != "" ) ? inferOut.className + ": " : "";
+        std::string className = ( !inferOut.className.empty() ) ? std::string(inferOut.className) + ": " : "";
         std::string label = className + cv::format("%.2f", inferOut.confidence);
 
         int baseLine;
@@ -284,4 +287,24 @@ std::pair<bool, std::string> verifyFile(const fs::path& path)
     return resp;
 }
 
+std::int64_t steadyClockMs() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::string_view internClassName( std::string_view name )
+{
+    static std::mutex mutex;
+    static std::set<std::string, std::less<>> names; // set nodes never move
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = names.find(name);
+    if ( it == names.end() )
+    {
+        it = names.emplace(name).first;
+    }
+    return *it;
+}
+
 }
\ No newline at end of file
@@ -0,0 +1,258 @@
+#include "cvtoolkit/video_index.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+
+namespace fs = std::filesystem;
+
+namespace cvt
+{
+
+/* Raw (no decode) FFmpeg mode with keyframe flags is relied upon from OpenCV 4.6 on */
+#if CV_VERSION_MAJOR > 4 || (CV_VERSION_MAJOR == 4 && CV_VERSION_MINOR >= 6)
+#define CVT_HAVE_RAW_DEMUX 1
+#endif
+
+namespace
+{
+
+const char IndexMagic[8] = { 'C', 'V', 'T', 'I', 'D', 'X', '0', '1' };
+
+struct IndexHeader
+{
+    char magic[8];
+    std::uint64_t videoSize;
+    std::int64_t videoMtime;
+    std::uint32_t nFrames;
+    std::uint32_t nKeyframes;
+};
+
+bool videoSignature(const std::string& videoPath, std::uint64_t& size, std::int64_t& mtime)
+{
+    std::error_code ec;
+    size = static_cast<std::uint64_t>(fs::file_size(videoPath, ec));
+    if ( ec )
+    {
+        return false;
+    }
+    mtime = static_cast<std::int64_t>(fs::last_write_time(videoPath, ec).time_since_epoch().count());
+    return !ec;
+}
+
+}
+
+bool VideoIndex::open(const std::string& videoPath, bool useSidecar, const std::atomic<bool>* cancel)
+{
+    const std::string indexPath = sidecarPath(videoPath);
+    if ( useSidecar && load(indexPath, videoPath) )
+    {
+        return true;
+    }
+
+    if ( !build(videoPath, cancel) )
+    {
+        return false;
+    }
+
+    if ( useSidecar && !save(indexPath, videoPath) )
+    {
+        std::cerr << ">>> [VideoIndex] Could not write " << indexPath << std::endl;
+    }
+    return true;
+}
+
+bool VideoIndex::build(const std::string& videoPath, const std::atomic<bool>* cancel)
+{
+    m_timestamps.clear();
+    m_keyframes.clear();
+
+#ifdef CVT_HAVE_RAW_DEMUX
+    cv::VideoCapture capture(videoPath, cv::CAP_FFMPEG);
+    if ( !capture.isOpened() || !capture.set(cv::CAP_PROP_FORMAT, -1) )
+    {
+        std::cerr << ">>> [VideoIndex] Raw demuxing is not available for " << videoPath << std::endl;
+        return false;
+    }
+
+    const double fps = capture.get(cv::CAP_PROP_FPS);
+    bool ptsValid = true;
+    int packetNum = 0;
+    std::vector<std::int64_t> keyframePts;
+    while ( capture.grab() )
+    {
+        if ( cancel && *cancel )
+        {
+            m_timestamps.clear();
+            m_keyframes.clear();
+            return false;
+        }
+
+        const double posMs = capture.get(cv::CAP_PROP_POS_MSEC);
+        ptsValid = ptsValid && (posMs >= 0.0);
+        m_timestamps.emplace_back(static_cast<std::int64_t>(posMs));
+        if ( capture.get(cv::CAP_PROP_LRF_HAS_KEY_FRAME) != 0.0 )
+        {
+            m_keyframes.emplace_back(packetNum);
+            keyframePts.emplace_back(m_timestamps.back());
+        }
+        ++packetNum;
+    }
+
+    if ( m_timestamps.empty() )
+    {
+        return false;
+    }
+
+    /* Packets come in decode order, presentation order is the sorted one.
+       With B-frames the two differ, so keyframes are found by their PTS among the sorted timestamps */
+    if ( ptsValid )
+    {
+        std::sort(m_timestamps.begin(), m_timestamps.end());
+        m_keyframes.clear();
+        for ( const std::int64_t pts : keyframePts )
+        {
+            auto it = std::lower_bound(m_timestamps.begin(), m_timestamps.end(), pts);
+            m_keyframes.emplace_back(static_cast<int>(it - m_timestamps.begin()));
+        }
+        std::sort(m_keyframes.begin(), m_keyframes.end());
+        m_keyframes.erase(std::unique(m_keyframes.begin(), m_keyframes.end()), m_keyframes.end());
+
+        const std::int64_t firstPts = m_timestamps.front();
+        for ( auto& ts : m_timestamps )
+        {
+            ts -= firstPts;
+        }
+    }
+    else
+    {
+        for ( size_t i = 0; i < m_timestamps.size(); ++i )
+        {
+            m_timestamps[i] = (fps > 0.0) ? static_cast<std::int64_t>(1000.0 * i / fps) : -1;
+        }
+    }
+
+    if ( m_keyframes.empty() || m_keyframes.front() != 0 )
+    {
+        m_keyframes.insert(m_keyframes.begin(), 0);
+    }
+    return true;
+#else
+    std::cerr << ">>> [VideoIndex] OpenCV " << CV_VERSION_MAJOR << "." << CV_VERSION_MINOR 
+              << " can not demux without decoding, index is not built" << std::endl;
+    return false;
+#endif
+}
+
+bool VideoIndex::load(const std::string& indexPath, const std::string& videoPath)
+{
+    std::ifstream ifs(indexPath, std::ios::binary);
+    if ( !ifs.good() )
+    {
+        return false;
+    }
+
+    IndexHeader header;
+    ifs.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if ( !ifs || std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 )
+    {
+        return false;
+    }
+
+    /* The sidecar is outdated if the video has been replaced */
+    std::uint64_t videoSize = 0;
+    std::int64_t videoMtime = 0;
+    if ( !videoSignature(videoPath, videoSize, videoMtime) 
+        || videoSize != header.videoSize || videoMtime != header.videoMtime )
+    {
+        return false;
+    }
+
+    std::vector<std::int64_t> timestamps(header.nFrames);
+    std::vector<int> keyframes(header.nKeyframes);
+    ifs.read(reinterpret_cast<char*>(timestamps.data()), timestamps.size() * sizeof(std::int64_t));
+    ifs.read(reinterpret_cast<char*>(keyframes.data()), keyframes.size() * sizeof(int));
+    if ( !ifs || timestamps.empty() || keyframes.empty() )
+    {
+        return false;
+    }
+
+    m_timestamps = std::move(timestamps);
+    m_keyframes = std::move(keyframes);
+    return true;
+}
+
+bool VideoIndex::save(const std::string& indexPath, const std::string& videoPath) const
+{
+    IndexHeader header;
+    std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+    if ( empty() || !videoSignature(videoPath, header.videoSize, header.videoMtime) )
+    {
+        return false;
+    }
+    header.nFrames = static_cast<std::uint32_t>(m_timestamps.size());
+    header.nKeyframes = static_cast<std::uint32_t>(m_keyframes.size());
+
+    std::ofstream ofs(indexPath, std::ios::binary | std::ios::trunc);
+    if ( !ofs.good() )
+    {
+        return false;
+    }
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(m_timestamps.data()), m_timestamps.size() * sizeof(std::int64_t));
+    ofs.write(reinterpret_cast<const char*>(m_keyframes.data()), m_keyframes.size() * sizeof(int));
+    return ofs.good();
+}
+
+bool VideoIndex::empty() const noexcept
+{
+    return m_timestamps.empty();
+}
+
+int VideoIndex::frames() const noexcept
+{
+    return static_cast<int>(m_timestamps.size());
+}
+
+int VideoIndex::keyframeBefore(int frameNum) const
+{
+    auto it = std::upper_bound(m_keyframes.begin(), m_keyframes.end(), frameNum);
+    return ( it == m_keyframes.begin() ) ? 0 : *(it - 1);
+}
+
+bool VideoIndex::isKeyframe(int frameNum) const
+{
+    return std::binary_search(m_keyframes.begin(), m_keyframes.end(), frameNum);
+}
+
+std::int64_t VideoIndex::timestamp(int frameNum) const
+{
+    if ( frameNum < 0 || frameNum >= frames() )
+    {
+        return -1;
+    }
+    return m_timestamps[frameNum];
+}
+
+int VideoIndex::frameAt(std::int64_t timestampMs) const
+{
+    auto it = std::upper_bound(m_timestamps.begin(), m_timestamps.end(), timestampMs);
+    return ( it == m_timestamps.begin() ) ? 0 : static_cast<int>(it - m_timestamps.begin()) - 1;
+}
+
+std::string VideoIndex::sidecarPath(const std::string& videoPath)
+{
+    return videoPath + ".cvtidx";
+}
+
+bool VideoIndex::supported() noexcept
+{
+#ifdef CVT_HAVE_RAW_DEMUX
+    return true;
+#else
+    return false;
+#endif
+}
+
+}
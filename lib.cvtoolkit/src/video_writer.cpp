@@ -0,0 +1,171 @@
+#include "cvtoolkit/video_writer.hpp"
+#include "cvtoolkit/thread_budget.hpp"
+
+#include <sstream>
+#include <chrono>
+
+namespace cvt
+{
+
+AsyncVideoWriter::AsyncVideoWriter(const Params& params)
+    : m_params(params)
+{
+}
+
+AsyncVideoWriter::~AsyncVideoWriter()
+{
+    release();
+}
+
+bool AsyncVideoWriter::write(const cv::Mat& frame)
+{
+    if ( frame.empty() )
+    {
+        return false;
+    }
+    if ( !m_opened && (m_pool || !open(frame)) )
+    {
+        ++m_dropped;
+        return false;
+    }
+
+    /* The pool bounds the queue: a buffer is free only when its frame has been encoded */
+    const std::int64_t waitForMs = ( m_params.policy == Policy::BLOCK ) ? 1000 : 0;
+    FrameHandle handle;
+    while ( !handle )
+    {
+        handle = m_pool->acquire(waitForMs);
+        if ( !handle && m_params.policy == Policy::DROP )
+        {
+            ++m_dropped;
+            return false;
+        }
+    }
+
+    frame.copyTo(handle->image);
+    m_queue.push(std::move(handle));
+
+    const int depth = m_queue.size();
+    int maxDepth = m_maxQueueDepth;
+    while ( depth > maxDepth && !m_maxQueueDepth.compare_exchange_weak(maxDepth, depth) );
+    return true;
+}
+
+void AsyncVideoWriter::release()
+{
+    m_stop = true;
+    if ( m_thread.joinable() )
+    {
+        m_thread.join();
+    }
+    if ( m_writer.isOpened() )
+    {
+        m_writer.release();
+    }
+    m_opened = false;
+}
+
+const AsyncVideoWriter::Params& AsyncVideoWriter::params() const noexcept
+{
+    return m_params;
+}
+
+bool AsyncVideoWriter::isOpened() const noexcept
+{
+    return m_opened;
+}
+
+int AsyncVideoWriter::queueDepth() const
+{
+    return m_queue.size();
+}
+
+int AsyncVideoWriter::maxQueueDepth() const noexcept
+{
+    return m_maxQueueDepth;
+}
+
+std::int64_t AsyncVideoWriter::written() const noexcept
+{
+    return m_written;
+}
+
+std::int64_t AsyncVideoWriter::dropped() const noexcept
+{
+    return m_dropped;
+}
+
+double AsyncVideoWriter::encodeLatency() const noexcept
+{
+    const std::int64_t written = m_written;
+    return ( written > 0 ) ? (m_encodeTimeUs / 1000.0) / written : 0.0;
+}
+
+double AsyncVideoWriter::maxEncodeLatency() const noexcept
+{
+    return m_maxEncodeTimeUs / 1000.0;
+}
+
+std::string AsyncVideoWriter::summary() const
+{
+    std::ostringstream oss;
+    oss << "[AsyncVideoWriter] " << m_params.path 
+        << ": written " << written() << ", dropped " << dropped() 
+        << ", encode " << encodeLatency() << " ms (max " << maxEncodeLatency() << " ms)"
+        << ", max queue depth " << maxQueueDepth() << "/" << m_params.queueSize;
+    return oss.str();
+}
+
+bool AsyncVideoWriter::open(const cv::Mat& frame)
+{
+    if ( m_params.fourcc.size() != 4 )
+    {
+        std::cerr << ">>> [AsyncVideoWriter] Invalid codec " << m_params.fourcc << std::endl;
+        return false;
+    }
+
+    const int fourcc = cv::VideoWriter::fourcc(m_params.fourcc[0], m_params.fourcc[1], 
+                                               m_params.fourcc[2], m_params.fourcc[3]);
+    const double fps = ( m_params.fps > 0.0 ) ? m_params.fps : 25.0;
+    m_writer.open(m_params.path, fourcc, fps, frame.size(), (frame.channels() == 3));
+    if ( !m_writer.isOpened() )
+    {
+        std::cerr << ">>> [AsyncVideoWriter] Could not open " << m_params.path << std::endl;
+        return false;
+    }
+
+    m_pool = std::make_shared<FramePool>(frame.size(), frame.type(), std::max(m_params.queueSize, 1));
+    m_opened = true;
+    m_stop = false;
+    m_thread = std::thread(&AsyncVideoWriter::encodeLoop, this);
+    return true;
+}
+
+void AsyncVideoWriter::encodeLoop()
+{
+    pinToBudget(threadBudget().opencv.cores);
+    while ( true )
+    {
+        auto handle = m_queue.pop1(100);
+        if ( !handle )
+        {
+            if ( m_stop )
+            {
+                break;
+            }
+            continue;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        m_writer.write((*handle)->image);
+        const std::int64_t elapsedUs = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+
+        m_encodeTimeUs += elapsedUs;
+        std::int64_t maxTime = m_maxEncodeTimeUs;
+        while ( elapsedUs > maxTime && !m_maxEncodeTimeUs.compare_exchange_weak(maxTime, elapsedUs) );
+        ++m_written;
+    }
+}
+
+}
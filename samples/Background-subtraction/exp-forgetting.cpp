@@ -7,6 +7,7 @@
 #include <cvtoolkit/cvplayer.hpp>
 #include <cvtoolkit/cvgui.hpp>
 #include <cvtoolkit/utils.hpp>
+#include <cvtoolkit/snapshot.hpp>
 
 
 const static std::string WinName = "ExpForgetting Background subtractor";
@@ -16,6 +17,7 @@ const cv::String argKeys =
         "{ @input i       |  0     | input stream }"
         "{ resize r       |  1.0   | resize scale factor }"
         "{ record e       |  false | do record }"
+        "{ snapshot s     |        | path to background model snapshot }"
         ;
 
 
@@ -157,6 +159,39 @@ public:
         m_alpha = alpha;
     }
 
+    /** @brief Saves the learned background model.
+    */
+    void saveState(cvt::SnapshotWriter& snapshot) const
+    {
+        snapshot.write(m_frameNum);
+        snapshot.write(m_background_32FC3);
+        snapshot.write(m_stdev2);
+    }
+
+    /** @brief Restores the background model saved earlier.
+
+    @return false if the snapshot is damaged or was taken at another resolution
+    */
+    bool loadState(cvt::SnapshotReader& snapshot, cv::Size imSize)
+    {
+        unsigned long long frameNum = 0;
+        cv::Mat background_32FC3, stdev2;
+        snapshot.read(frameNum);
+        snapshot.read(background_32FC3);
+        snapshot.read(stdev2);
+        if ( !snapshot.good() || background_32FC3.size() != imSize || stdev2.size() != imSize
+            || background_32FC3.type() != CV_32FC3 || stdev2.type() != CV_32FC3 )
+        {
+            return false;
+        }
+
+        m_frameNum = frameNum;
+        m_background_32FC3 = background_32FC3;
+        m_stdev2 = stdev2;
+        m_MahalanobisDist = cv::Mat::zeros(m_background_32FC3.size(), CV_32FC1);
+        return true;
+    }
+
 private:
     unsigned long long m_frameNum { 0 };
     double m_thresh2 { 16.0 };
@@ -212,6 +247,7 @@ int main(int argc, char** argv)
     double scaleFactor = parser.get<double>("resize");
     bool doResize = (scaleFactor != 1.0);
     bool record = parser.get<bool>("record");
+    std::string snapshotPath = parser.get<std::string>("snapshot");
     
     if (!parser.check())
     {
@@ -234,8 +270,19 @@ int main(int argc, char** argv)
     std::cout << ">>> Input: " << input << std::endl;
     std::cout << ">>> Resolution: " << player->frame0().size() << std::endl;
     std::cout << ">>> Record: " << std::boolalpha << record << std::endl;
+    std::cout << ">>> Snapshot: " << (( snapshotPath.empty() ) ? "-" : snapshotPath) << std::endl;
 
     bgSubtractor = createBackgroundSubtractorEF(Thresh * Thresh, Alpha / 1000.f);
+    if ( !snapshotPath.empty() )
+    {
+        cvt::SnapshotReader snapshot;
+        if ( cvt::loadSnapshot(snapshotPath, snapshot) && bgSubtractor->loadState(snapshot, player->frame0().size()) )
+        {
+            std::cout << ">>> Background model restored from " << snapshotPath << std::endl;
+        }
+    }
+    const int snapshotPeriodFrames = std::max(1, static_cast<int>(player->fps() * 60)); // once a minute
+    int framesSinceSnapshot = 0;
 
     /* Main loop */
     bool loop = true;
@@ -273,6 +320,15 @@ int main(int argc, char** argv)
             // }
         }
 
+        /* Keep the learned model for the next start */
+        if ( !snapshotPath.empty() && ++framesSinceSnapshot >= snapshotPeriodFrames )
+        {
+            framesSinceSnapshot = 0;
+            cvt::SnapshotWriter snapshot;
+            bgSubtractor->saveState(snapshot);
+            cvt::saveSnapshot(snapshotPath, snapshot);
+        }
+
         /* Display info */
         if ( fgMask.channels() == 1 )
         {
@@ -293,6 +349,16 @@ int main(int argc, char** argv)
         gui.imshow(out, record);
     }
     
+    if ( !snapshotPath.empty() )
+    {
+        cvt::SnapshotWriter snapshot;
+        bgSubtractor->saveState(snapshot);
+        if ( !cvt::saveSnapshot(snapshotPath, snapshot) )
+        {
+            std::cerr << ">>> Could not save snapshot to " << snapshotPath << std::endl;
+        }
+    }
+
     std::cout << ">>> " << metrics->summary() << std::endl;
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
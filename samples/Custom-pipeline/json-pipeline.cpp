@@ -0,0 +1,82 @@
+#include <signal.h>
+#include <iostream>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+#include <opencv2/core.hpp>
+
+#include <cvtoolkit/pipeline.hpp>
+
+
+const static std::string WinName = "JSON pipeline";
+
+const cv::String argKeys =
+        "{ help usage ?   |        | print help }"
+        "{ @json j        |        | path to json }"
+        "{ node n         |pipeline| name of the pipeline node }"
+        ;
+
+static cvt::Pipeline pipeline;
+
+static std::atomic<bool> interrupted { false };
+
+
+void signalHandler(int code)
+{
+    /* Only the flag: stopping wakes up stage threads, which is not allowed here */
+    interrupted = true;
+}
+
+
+int main(int argc, char** argv)
+{
+    signal(SIGINT, signalHandler); // Handle Ctrl+C exit
+
+    /* Parse command-line args */
+    cv::CommandLineParser parser(argc, argv, argKeys);
+    parser.about(WinName);
+    if (parser.has("help"))
+    {
+        parser.printMessage();
+        return 0;
+    }
+
+    const std::string jsonPath = parser.get<std::string>("@json");
+    const std::string nodeName = parser.get<std::string>("node");
+
+    if (!parser.check())
+    {
+        parser.printErrors();
+        return 0;
+    }
+
+    std::cout << ">>> JSON file: " << (( jsonPath.empty() ) ? "-" : jsonPath) << std::endl;
+
+    /* Build the graph */
+    if ( !pipeline.load(jsonPath, nodeName) )
+    {
+        return -1;
+    }
+
+    /* Every stage runs on its own thread, so the main one only watches */
+    pipeline.start();
+    int ticks = 0;
+    while ( pipeline.running() && !interrupted )
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        if ( ++ticks % 100 == 0 )
+        {
+            std::cout << ">>> " << pipeline.summary() << std::endl;
+        }
+    }
+    if ( interrupted )
+    {
+        pipeline.stop();
+    }
+    pipeline.wait();
+
+    std::cout << ">>> " << pipeline.summary() << std::endl;
+    std::cout << ">>> Program successfully finished" << std::endl;
+    return 0;
+}
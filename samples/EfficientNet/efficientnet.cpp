@@ -65,9 +65,16 @@ int main(int argc, char** argv)
     std::shared_ptr<EfficientNetSettings> jSettings = std::make_shared<EfficientNetSettings>(jsonPath, SampleName);
     std::cout << "[" << TitleName << "]" << jSettings->summary() << std::endl;
 
+    /* Split cores between OpenCV, inference and detector threads before any of them start */
+    if ( !jSettings->threadBudget().empty() )
+    {
+        cvt::setThreadBudget(jSettings->threadBudget());
+    }
+
     /* Open stream */
     std::shared_ptr<cvt::OpenCVPlayer> player = std::make_shared<cvt::OpenCVPlayer>(jSettings->input(), 
                                                                                     jSettings->inputSize());
+    player->setWriterParams(jSettings->recordParams());
 
     /* Create GUI */
     auto metrics = std::make_shared<cvt::MetricMaster>();
@@ -208,6 +215,10 @@ int main(int argc, char** argv)
     }
     
     std::cout << ">>> Inference metrics: " << metrics->summary() << std::endl;
+    if ( player->writer() )
+    {
+        std::cout << ">>> " << player->writer()->summary() << std::endl;
+    }
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
 }
@@ -1,11 +1,13 @@
 #include <signal.h>
 #include <iostream>
+#include <atomic>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 #include <cvtoolkit/cvgui.hpp>
+#include <cvtoolkit/frame_dispatcher.hpp>
 #include <cvtoolkit/detector/optflow_motion_detector.hpp>
 
 
@@ -20,20 +22,17 @@ const cv::String argKeys =
         "{ @json j        |        | path to json }"
         ;
 
-static bool loop = true;
+static std::atomic<bool> loop { true };
 
-static const int MaxItemsInQueue = 100;
+static const int MaxItemsInQueue = 64;
 
 std::unique_ptr<cvt::DetectorThreadManager> detectorThread;
 
 
 void signalHandler(int code)
 {
+    /* Only the flag: the detector is finished by the main loop, locking is not allowed here */
     loop = false;
-    if ( detectorThread )
-    {
-        detectorThread->finish();
-    }
 }
 
 
@@ -82,13 +81,36 @@ int main(int argc, char** argv)
     /* Task-specific declarations */
     cvt::Detector::InitializeData initData { "optflow-motion-detector", imSize, fps, jsonPath };
     std::shared_ptr<cvt::OptflowMotionDetector> motionDetector = std::make_shared<cvt::OptflowMotionDetector>(initData);
-    detectorThread = std::make_unique<cvt::DetectorThreadManager>(motionDetector);
+    detectorThread = std::make_unique<cvt::DetectorThreadManager>(motionDetector, 0, MaxItemsInQueue);
+    detectorThread->setAdmission(motionDetector->settings()->admission());
+    if ( !motionDetector->settings()->snapshotPath().empty() )
+    {
+        /* Learned motion statistics survive restarts */
+        detectorThread->setSnapshot(motionDetector->settings()->snapshotPath(), motionDetector->settings()->snapshotPeriodMs());
+    }
+
+    /* One frame handle is shared by all subscribed detectors */
+    cvt::FrameDispatcher dispatcher;
+    dispatcher.subscribe(*detectorThread);
+
+    /* Frames are shared with the detector thread, so take them from a pool instead of reusing one buffer.
+       Queued frames, the one being processed and the one being captured are in use at a time */
+    auto framePool = std::make_shared<cvt::FramePool>(imSize, player->frame0().type(), 
+                                                      detectorThread->iDataQueue.capacity() + 2);
+
+    /* Detector-resolution planes are produced once per frame in the main thread */
+    cvt::IngestStage ingest(motionDetector->requiredPlanes());
+
+    /* Events are reported as soon as they come */
+    detectorThread->onEvent([](const cvt::Detector::OutputData& eventItem) {
+        std::cout << ">>> [EVENT]: " << eventItem.eventDescr << " at " << eventItem.eventTimestamp << std::endl;
+    });
 
     /* Detector loop */
     detectorThread->run();
 
     /* Main loop */
-    cv::Mat frame, out;
+    cv::Mat out;
     while ( loop )
     {
         auto m = metrics->measure();
@@ -106,35 +128,24 @@ int main(int argc, char** argv)
         }
 
         /* Capturing */
-        *player >> frame;
-        if ( frame.empty() ) 
+        cvt::FrameHandle frameHandle = framePool->acquire(1000);
+        if ( !frameHandle )
         {
+            std::cout << ">>> Frame pool exhausted" << std::endl;
             break;
         }
-
-        /* Computer vision magic */
+        *player >> frameHandle;
+        const cv::Mat& frame = frameHandle->image;
+        if ( frame.empty() ) 
         {
-            if ( detectorThread->iDataQueue.size() >= MaxItemsInQueue )
-            {
-                detectorThread->iDataQueue.clear();
-            }
-
-            cvt::Detector::InputData iData
-            {
-                !frame.empty(),
-                frame.data,
-                static_cast<unsigned int>(frame.type()),
-                static_cast<unsigned int>(frame.step.p[0]),
-                player->timestamp()
-            };
-            detectorThread->iDataQueue.push(std::move(iData));
+            break;
         }
+        ingest.process(frame, frameHandle->planes);
 
-        /* Check for events */
-        while ( detectorThread->oDataQueue.size() > 0 )
+        /* Computer vision magic */
         {
-            const auto& sharedEventItem = detectorThread->oDataQueue.pop1(1000);
-            std::cout << ">>> [EVENT]: " << sharedEventItem->eventDescr << " at " << sharedEventItem->eventTimestamp << std::endl;
+            /* If the detector lags behind, the oldest queued frame is dropped */
+            dispatcher.publish(frameHandle);
         }
 
         /* Display info */
@@ -164,8 +175,11 @@ int main(int argc, char** argv)
     {
         detectorThread->finish();
     }
-    detectorThread->detectorThread.join();
-    
+    detectorThread->join();
+
+    std::cout << ">>> Frame pool: " << framePool->summary() << std::endl;
+    std::cout << ">>> " << dispatcher.summary() << std::endl;
+
     std::cout << ">>> Main thread metrics (with waitKey): " << metrics->summary() << std::endl;
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
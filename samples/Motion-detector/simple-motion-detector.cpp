@@ -9,6 +9,7 @@
 #include "cvtoolkit/cvgui.hpp"
 #include "cvtoolkit/utils.hpp"
 #include "cvtoolkit/settings.hpp"
+#include "cvtoolkit/sampling_policy.hpp"
 
 
 const static std::string WinName = "Motion detection via frame differencing";
@@ -62,6 +63,8 @@ int main(int argc, char** argv)
     int areaMotionThresh = 127;
     double decisionThresh = 0.5;
     std::int64_t processFreqMs = 100;
+    cvt::SamplingSettings samplingSettings;
+    samplingSettings.periodMs = processFreqMs;
     cvt::Areas areas;
     if ( !jsonPath.empty() ) 
     {
@@ -83,10 +86,11 @@ int main(int argc, char** argv)
                     {
                         decisionThresh = 255 * static_cast<double>(fdiffConfig["decisionThresh"]);
                     }
-                    if ( fdiffConfig["processFreqMs"].empty() )
+                    if ( !fdiffConfig["processFreqMs"].empty() )
                     {
                         processFreqMs = static_cast<std::int64_t>(fdiffConfig["processFreqMs"]);
                     }
+                    samplingSettings = cvt::SamplingSettings::fromJson(fdiffConfig["sampling"], processFreqMs);
 
                     areas = cvt::parseAreas(fdiffConfig["areas"], imSize);
                 }
@@ -111,7 +115,7 @@ int main(int argc, char** argv)
     bool loop = true;
     cv::Mat frame, prevFrame, fdiff, out;
     cv::Mat maskedFrame;
-    std::int64_t lastFrameMs = -1;
+    cvt::SamplingPolicy sampling(samplingSettings);
     bool processNow = true;
     while ( loop )
     {
@@ -134,24 +138,8 @@ int main(int argc, char** argv)
         {
             auto m = metrics->measure();
 
-            /* Process frames with given frequency */
-            processNow = true;
-            if ( lastFrameMs == -1 )
-            {
-                lastFrameMs = player->timestamp();
-            }
-            else
-            {
-                if ( processFreqMs > 0 )
-                {
-                    std::int64_t elapsed = player->timestamp() - lastFrameMs;
-                    if ( elapsed < processFreqMs )
-                    {
-                        processNow = false;
-                    }
-                    lastFrameMs = player->timestamp() - (player->timestamp() % processFreqMs);
-                }
-            }
+            /* Process frames the sampling policy picks */
+            processNow = sampling.admit(player->timestamp(), player->isKeyframe());
 
             if ( prevFrame.empty() )
             {
@@ -166,6 +154,7 @@ int main(int argc, char** argv)
 
                 /* Mask frame */
                 cv::bitwise_and(fdiff, areaMask, fdiff);
+                sampling.observe(player->timestamp(), cv::countNonZero(fdiff) > 0);
 
                 cv::swap(frame, prevFrame);
             }
@@ -187,6 +176,7 @@ int main(int argc, char** argv)
         gui.imshow(out, record);
     }
     
+    std::cout << ">>> " << sampling.summary() << std::endl;
     std::cout << ">>> " << metrics->summary() << std::endl;
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
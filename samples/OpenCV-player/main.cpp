@@ -4,6 +4,7 @@
 #include <opencv2/highgui.hpp>
 
 #include <cvtoolkit/cvplayer.hpp>
+#include <cvtoolkit/frame_store.hpp>
 #include <cvtoolkit/cvgui.hpp>
 #include <cvtoolkit/utils.hpp>
 
@@ -15,6 +16,9 @@ const cv::String argKeys =
         "{ @input i       |  0     | input stream }"
         "{ resize r       |  1.0   | resize scale factor }"
         "{ record e       |  false | do record }"
+        "{ prefetch p     |  0     | decode-ahead ring size (0 - disabled) }"
+        "{ live l         |  false | always read the newest frame of a live stream }"
+        "{ store s        |        | save input frames into a raw frame store (*.cvr) for decode-free replay }"
         ;
 
 
@@ -39,6 +43,9 @@ int main(int argc, char** argv)
     double scaleFactor = parser.get<double>("resize");
     bool doResize = (scaleFactor != 1.0);
     bool record = parser.get<bool>("record");
+    int prefetch = parser.get<int>("prefetch");
+    bool live = parser.get<bool>("live");
+    std::string storePath = parser.get<std::string>("store");
     
     if (!parser.check())
     {
@@ -48,6 +55,20 @@ int main(int argc, char** argv)
 
     /* Open stream */
     std::shared_ptr<cvt::OpenCVPlayer> player = std::make_shared<cvt::OpenCVPlayer>(input, scaleFactor);
+    if ( prefetch > 0 )
+    {
+        player->enablePrefetch(prefetch);
+    }
+    if ( live )
+    {
+        player->enableLiveMode();
+    }
+
+    cvt::FrameStoreWriter store;
+    if ( !storePath.empty() )
+    {
+        store.open(storePath, player->fps());
+    }
 
     /* Create GUI */
     auto metrics = std::make_shared<cvt::MetricMaster>();
@@ -56,6 +77,8 @@ int main(int argc, char** argv)
     std::cout << ">>> Input: " << input << std::endl;
     std::cout << ">>> Resolution: " << player->frame0().size() << std::endl;
     std::cout << ">>> Record: " << std::boolalpha << record << std::endl;
+    std::cout << ">>> Prefetch: " << prefetch << std::endl;
+    std::cout << ">>> Store: " << (storePath.empty() ? "none" : storePath) << std::endl;
 
     /* Main loop */
     bool loop = true;
@@ -76,6 +99,10 @@ int main(int argc, char** argv)
         {
             break;
         }
+        if ( store.isOpened() )
+        {
+            store.write(frame, player->timestamp());
+        }
 
         /* Computer vision magic */
         {
@@ -98,6 +125,14 @@ int main(int argc, char** argv)
     }
     
     std::cout << ">>> " << metrics->summary() << std::endl;
+    if ( player->prefetching() )
+    {
+        std::cout << ">>> Prefetch underruns: " << player->prefetchUnderruns() << std::endl;
+    }
+    if ( player->liveMode() )
+    {
+        std::cout << ">>> Skipped frames: " << player->skippedFrames() << std::endl;
+    }
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
 }
@@ -1,16 +1,20 @@
 #include <signal.h>
 #include <iostream>
+#include <atomic>
 
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/highgui.hpp>
 
 #include <cvtoolkit/cvgui.hpp>
+#include <cvtoolkit/frame_dispatcher.hpp>
 #include <cvtoolkit/detector/yolo_object_detector.hpp>
+#include <cvtoolkit/detector/cascade_detector.hpp>
 
 
 const static std::string WinName = "YOLO object detection";
 const static std::string DetName = "yolo-object-detector";
+const static std::string CascadeName = "cascade-detector";
 
 const cv::String argKeys =
         "{ help usage ?   |        | print help }"
@@ -18,23 +22,21 @@ const cv::String argKeys =
         "{ resize r       |  1.0   | resize scale factor }"
         "{ record e       |  false | do record }"
         "{ display d      |  true  | whether display window or not }"
+        "{ cascade c      |  false | run YOLO only on frames with motion }"
         "{ @json j        |        | path to json }"
         ;
 
-static bool loop = true;
+static std::atomic<bool> loop { true };
 
-static const int MaxItemsInQueue = 100;
+static const int MaxItemsInQueue = 64;
 
 std::unique_ptr<cvt::DetectorThreadManager> detectorThread;
 
 
 void signalHandler(int code)
 {
+    /* Only the flag: the detector is finished by the main loop, locking is not allowed here */
     loop = false;
-    if ( detectorThread )
-    {
-        detectorThread->finish();
-    }
 }
 
 
@@ -56,6 +58,7 @@ int main(int argc, char** argv)
     const bool doResize = (scaleFactor != 1.0);
     const bool record = parser.get<bool>("record");
     const bool display = parser.get<bool>("display");
+    const bool cascade = parser.get<bool>("cascade");
     const std::string jsonPath = parser.get<std::string>("@json");
     
     if (!parser.check())
@@ -78,18 +81,42 @@ int main(int argc, char** argv)
     std::cout << ">>> Formal FPS: " << fps << std::endl;
     std::cout << ">>> Record: " << std::boolalpha << record << std::endl;
     std::cout << ">>> Display: " << std::boolalpha << display << std::endl;
+    std::cout << ">>> Cascade: " << std::boolalpha << cascade << std::endl;
     std::cout << ">>> JSON file: " << (( jsonPath.empty() ) ? "-" : jsonPath) << std::endl;
 
     /* Task-specific declarations */
     cvt::Detector::InitializeData initData { DetName, imSize, fps, jsonPath };
     std::shared_ptr<cvt::YOLOObjectDetector> objectDetector = std::make_shared<cvt::YOLOObjectDetector>(initData);
-    detectorThread = std::make_unique<cvt::DetectorThreadManager>(objectDetector);
+    std::shared_ptr<cvt::Detector> detector = objectDetector;
+    if ( cascade )
+    {
+        /* A cheap motion gate decides which frames are worth a forward pass */
+        cvt::Detector::InitializeData cascadeInitData { CascadeName, imSize, fps, jsonPath };
+        detector = std::make_shared<cvt::CascadeDetector>(cascadeInitData, objectDetector);
+    }
+    detectorThread = std::make_unique<cvt::DetectorThreadManager>(detector, 0, MaxItemsInQueue);
+    detectorThread->setAdmission(objectDetector->settings()->admission());
+    detectorThread->setPipelineDepth(objectDetector->settings()->pipelineDepth());
+    detectorThread->setBatchSize(objectDetector->settings()->batchSize());
+
+    /* One frame handle is shared by all subscribed detectors */
+    cvt::FrameDispatcher dispatcher;
+    dispatcher.subscribe(*detectorThread);
+
+    /* Frames are shared with the detector thread, so take them from a pool instead of reusing one buffer.
+       Queued frames, frames of queued events, the one being processed and the one being captured are in use at a time */
+    auto framePool = std::make_shared<cvt::FramePool>(imSize, player->frame0().type(), 
+        detectorThread->iDataQueue.capacity() + detectorThread->oDataQueue.capacity() + 2);
+
+    /* Detector-resolution planes are produced once per frame in the main thread */
+    cvt::IngestStage ingest(detector->requiredPlanes());
 
     /* Detector loop */
     detectorThread->run();
 
     /* Main loop */
-    cv::Mat frame, out;
+    cv::Mat out;
+    std::vector<cvt::Detector::OutputData> events;
     std::shared_ptr<cv::Mat> detailedFramePtr;
     if ( display )
     {
@@ -112,44 +139,40 @@ int main(int argc, char** argv)
         }
 
         /* Capturing */
-        *player >> frame;
+        cvt::FrameHandle frameHandle = framePool->acquire(1000);
+        if ( !frameHandle )
+        {
+            std::cout << ">>> Frame pool exhausted" << std::endl;
+            break;
+        }
+        *player >> frameHandle;
+        const cv::Mat& frame = frameHandle->image;
         if ( frame.empty() ) 
         {
             break;
         }
+        ingest.process(frame, frameHandle->planes);
 
         /* Computer vision magic */
         {
-            if ( detectorThread->iDataQueue.size() >= MaxItemsInQueue )
-            {
-                std::cout << ">>> Queue overflow. Do cleaning ..." << std::endl;
-                detectorThread->iDataQueue.clear();
-            }
-
-            cvt::Detector::InputData iData
-            {
-                !frame.empty(),
-                frame.data,
-                static_cast<unsigned int>(frame.type()),
-                static_cast<unsigned int>(frame.step.p[0]),
-                player->timestamp()
-            };
-            detectorThread->iDataQueue.push(std::move(iData));
+            /* If the detector lags behind, the oldest queued frame is dropped */
+            dispatcher.publish(frameHandle);
         }
 
         /* Check for events */
-        while ( detectorThread->oDataQueue.size() > 0 )
+        detectorThread->recycle(events);
+        detectorThread->drain(events);
+        for ( const auto& eventItem : events )
         {
-            const auto& sharedEventItem = detectorThread->oDataQueue.pop1(1000);
-            std::cout << ">>> [EVENT]: " << sharedEventItem->eventDescr << ":";
-            for (const auto& inferOut : sharedEventItem->eventInferOuts)
+            std::cout << ">>> [EVENT]: " << eventItem.eventDescr << ":";
+            for (const auto& inferOut : eventItem.eventInferOuts)
             {
                 std::cout << " " << inferOut.className;
             }
-            std::cout << " at " << sharedEventItem->eventTimestamp << std::endl;
-            if ( !sharedEventItem->eventDetailedFrame.empty() )
+            std::cout << " at " << eventItem.eventTimestamp << std::endl;
+            if ( detailedFramePtr )
             {
-                *detailedFramePtr = sharedEventItem->eventDetailedFrame;
+                eventItem.detailedFrame(objectDetector->settings()->detectorResolution(), *detailedFramePtr);
             }
         }
 
@@ -157,7 +180,15 @@ int main(int argc, char** argv)
         if ( record || display )
         {
             cv::Size detSize = objectDetector->settings()->detectorResolution();
-            cv::resize(frame, out, detSize);
+            const cv::Mat* detPlane = frameHandle->planes.find(cvt::PlaneSpec::Format::BGR, detSize);
+            if ( detPlane )
+            {
+                detPlane->copyTo(out);
+            }
+            else
+            {
+                cv::resize(frame, out, detSize);
+            }
             cvt::drawAreaMaskNeg(out, objectDetector->settings()->areas(), 0.8);
             if ( record )
             {
@@ -183,8 +214,11 @@ int main(int argc, char** argv)
     {
         detectorThread->finish();
     }
-    detectorThread->detectorThread.join();
-    
+    detectorThread->join();
+
+    std::cout << ">>> Frame pool: " << framePool->summary() << std::endl;
+    std::cout << ">>> " << dispatcher.summary() << std::endl;
+
     std::cout << ">>> Main thread metrics (with waitKey): " << metrics->summary() << std::endl;
     std::cout << ">>> Program successfully finished" << std::endl;
     return 0;
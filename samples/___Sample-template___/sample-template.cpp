@@ -50,9 +50,16 @@ int main(int argc, char** argv)
     const auto jSettings = std::make_shared<cvt::JsonSettings>(settingsPath, SampleName);
     logger->debug(jSettings->summary());
 
+    /* Split cores between OpenCV, inference and detector threads before any of them start */
+    if ( !jSettings->threadBudget().empty() )
+    {
+        cvt::setThreadBudget(jSettings->threadBudget());
+    }
+
     /* Open stream */
     std::shared_ptr<cvt::OpenCVPlayer> player = std::make_shared<cvt::OpenCVPlayer>(jSettings->input(), 
                                                                                     jSettings->inputSize());
+    player->setWriterParams(jSettings->recordParams());
 
     /* Create GUI */
     auto metrics = std::make_shared<cvt::MetricMaster>();
@@ -138,6 +145,10 @@ int main(int argc, char** argv)
     }
     
     logger->info("Inference metrics: {}", metrics->summary());
+    if ( player->writer() )
+    {
+        logger->info(player->writer()->summary());
+    }
     logger->info("Program successfully finished");
     return 0;
 }